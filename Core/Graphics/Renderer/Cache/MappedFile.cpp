@@ -0,0 +1,118 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#include "stdafx.h"
+#include "MappedFile.h"
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace Graphics { namespace Renderer { namespace Cache
+{
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+#ifdef _WIN32
+	nbBool MappedFile::open(const std::string& path)
+	{
+		close();
+
+		m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (m_file == INVALID_HANDLE_VALUE)
+		{
+			m_file = nullptr;
+			return false;
+		}
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(m_file, &size) || !size.QuadPart)
+		{
+			close();
+			return false;
+		}
+
+		m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!m_mapping)
+		{
+			close();
+			return false;
+		}
+
+		m_data = (const nbUint8*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!m_data)
+		{
+			close();
+			return false;
+		}
+
+		m_size = (nbUint64)size.QuadPart;
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (m_data)
+			UnmapViewOfFile(m_data);
+
+		if (m_mapping)
+			CloseHandle(m_mapping);
+
+		if (m_file)
+			CloseHandle(m_file);
+
+		m_data = nullptr;
+		m_mapping = nullptr;
+		m_file = nullptr;
+		m_size = 0u;
+	}
+#else
+	nbBool MappedFile::open(const std::string& path)
+	{
+		close();
+
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat fileStat;
+		if (fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0)
+		{
+			::close(fd);
+			return false;
+		}
+
+		// The mapping stays valid once the descriptor is closed.
+		void* data = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+
+		if (data == MAP_FAILED)
+			return false;
+
+		m_data = (const nbUint8*)data;
+		m_size = (nbUint64)fileStat.st_size;
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (m_data)
+			munmap((void*)m_data, (size_t)m_size);
+
+		m_data = nullptr;
+		m_size = 0u;
+	}
+#endif
+
+}}}
@@ -0,0 +1,49 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include <string>
+
+namespace Graphics { namespace Renderer { namespace Cache
+{
+// Read only memory mapping of a whole file. Pages are loaded by the system on first access.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	nbBool open(const std::string& path);
+	void close();
+
+	const nbUint8* getData() const;
+	nbUint64 getSize() const;
+
+private:
+	const nbUint8* m_data = nullptr;
+	nbUint64 m_size = 0u;
+
+#ifdef _WIN32
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+#endif
+};
+
+inline const nbUint8* MappedFile::getData() const
+{
+	return m_data;
+}
+
+inline nbUint64 MappedFile::getSize() const
+{
+	return m_size;
+}
+}}}
@@ -0,0 +1,189 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#include "stdafx.h"
+#include "SceneCache.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+namespace Graphics { namespace Renderer { namespace Cache
+{
+	const nbUint32 SceneCache::s_magic = 0x4353424Eu; // "NBSC"
+
+	// Increment when a section layout changes, older files are then ignored.
+	const nbUint32 SceneCache::s_version = 1u;
+
+	const nbUint64 SceneCache::s_sectionAlignment = 64u;
+
+	namespace
+	{
+		// FNV-1a
+		nbUint64 hashBytes(const void* data, nbUint64 size, nbUint64 hash = 0xcbf29ce484222325ull)
+		{
+			const nbUint8* bytes = (const nbUint8*)data;
+			for (nbUint64 i = 0u; i < size; ++i)
+			{
+				hash ^= bytes[i];
+				hash *= 0x100000001b3ull;
+			}
+
+			return hash;
+		}
+
+		nbUint64 alignOffset(nbUint64 offset, nbUint64 alignment)
+		{
+			return (offset + alignment - 1u) / alignment * alignment;
+		}
+	}
+
+	void SceneCacheWriter::addSection(SceneCacheSection type, nbUint32 meshIdx, const void* data, nbUint32 elementSize, nbUint64 nbElements)
+	{
+		m_sections.push_back({ type, meshIdx, data, elementSize, nbElements });
+	}
+
+	nbBool SceneCacheWriter::write(const std::string& path, nbUint64 sourceKey) const
+	{
+		using FileHeader = SceneCache::FileHeader;
+		using SectionEntry = SceneCache::SectionEntry;
+
+		std::vector<PendingSection> sections = m_sections;
+		std::sort(sections.begin(), sections.end(), [](const PendingSection& a, const PendingSection& b)
+		{
+			return a.type != b.type ? a.type < b.type : a.meshIdx < b.meshIdx;
+		});
+
+		FileHeader header;
+		header.magic = SceneCache::s_magic;
+		header.version = SceneCache::s_version;
+		header.sourceKey = sourceKey;
+		header.nbSections = (nbUint32)sections.size();
+		header.nbMeshes = 0u;
+
+		std::vector<SectionEntry> entries(sections.size());
+		nbUint64 offset = sizeof(FileHeader) + sections.size() * sizeof(SectionEntry);
+
+		for (size_t i = 0u; i < sections.size(); ++i)
+		{
+			offset = alignOffset(offset, SceneCache::s_sectionAlignment);
+
+			entries[i].type = sections[i].type;
+			entries[i].meshIdx = sections[i].meshIdx;
+			entries[i].elementSize = sections[i].elementSize;
+			entries[i].padding = 0u;
+			entries[i].offset = offset;
+			entries[i].nbElements = sections[i].nbElements;
+
+			header.nbMeshes = std::max(header.nbMeshes, sections[i].meshIdx + 1u);
+			offset += sections[i].elementSize * sections[i].nbElements;
+		}
+
+		// Written to a temporary file first, a partial cache is never opened.
+		const std::string tmpPath = path + ".tmp";
+		{
+			std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+			if (!file)
+			{
+				NEBULA_TRACE("SceneCacheWriter::write - Unable to create the cache file");
+				return false;
+			}
+
+			file.write((const char*)&header, sizeof(header));
+			file.write((const char*)entries.data(), entries.size() * sizeof(SectionEntry));
+
+			static const char zeros[64] = {};
+			nbUint64 position = sizeof(FileHeader) + entries.size() * sizeof(SectionEntry);
+
+			for (size_t i = 0u; i < sections.size(); ++i)
+			{
+				file.write(zeros, entries[i].offset - position);
+				file.write((const char*)sections[i].data, sections[i].elementSize * sections[i].nbElements);
+				position = entries[i].offset + sections[i].elementSize * sections[i].nbElements;
+			}
+
+			if (!file)
+			{
+				NEBULA_TRACE("SceneCacheWriter::write - Unable to write the cache file");
+				return false;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tmpPath, path, error);
+
+		return !error;
+	}
+
+	std::unique_ptr<SceneCache> SceneCache::open(const std::string& path, nbUint64 sourceKey)
+	{
+		std::unique_ptr<SceneCache> cache(new SceneCache());
+		if (!cache->m_file.open(path))
+			return nullptr;
+
+		const nbUint8* data = cache->m_file.getData();
+		const nbUint64 size = cache->m_file.getSize();
+
+		if (size < sizeof(FileHeader))
+			return nullptr;
+
+		const FileHeader* header = (const FileHeader*)data;
+		if (header->magic != s_magic || header->version != s_version || header->sourceKey != sourceKey)
+			return nullptr;
+
+		if (size < sizeof(FileHeader) + header->nbSections * sizeof(SectionEntry))
+			return nullptr;
+
+		const SectionEntry* sections = (const SectionEntry*)(data + sizeof(FileHeader));
+		for (nbUint32 i = 0u; i < header->nbSections; ++i)
+		{
+			if (sections[i].offset + sections[i].elementSize * sections[i].nbElements > size)
+			{
+				NEBULA_TRACE("SceneCache::open - Truncated cache file");
+				return nullptr;
+			}
+		}
+
+		cache->m_header = header;
+		cache->m_sections = sections;
+		return cache;
+	}
+
+	nbUint64 SceneCache::computeSourceKey(const std::string& sourcePath)
+	{
+		std::error_code error;
+		const nbUint64 fileSize = (nbUint64)std::filesystem::file_size(sourcePath, error);
+		const auto writeTime = std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count();
+
+		nbUint64 key = hashBytes(sourcePath.data(), sourcePath.size());
+		key = hashBytes(&fileSize, sizeof(fileSize), key);
+		key = hashBytes(&writeTime, sizeof(writeTime), key);
+
+		return key;
+	}
+
+	std::string SceneCache::getCachePath(const std::string& sourcePath)
+	{
+		return sourcePath + ".nbscene";
+	}
+
+	const SceneCache::SectionEntry* SceneCache::findSection(SceneCacheSection type, nbUint32 meshIdx) const
+	{
+		const SectionEntry* end = m_sections + m_header->nbSections;
+
+		const SectionEntry* section = std::lower_bound(m_sections, end, std::make_pair(type, meshIdx),
+			[](const SectionEntry& entry, const std::pair<SceneCacheSection, nbUint32>& key)
+		{
+			return entry.type != key.first ? entry.type < key.first : entry.meshIdx < key.second;
+		});
+
+		if (section == end || section->type != type || section->meshIdx != meshIdx)
+			return nullptr;
+
+		return section;
+	}
+
+}}}
@@ -0,0 +1,162 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include "MappedFile.h"
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace Graphics { namespace Renderer { namespace Cache
+{
+enum class SceneCacheSection : nbUint32
+{
+	VertexPositions,
+	VertexNormals,
+	VertexTangents,
+	VertexBitangents,
+	VertexTexCoords,
+	Indices,
+	TrianglePackets,
+	BvhNodes,
+	BvhPackets,
+	BvhCompressedNodes
+};
+
+// Array stored in a cache file. Points directly into the mapping, valid while the SceneCache is alive.
+template <typename T>
+struct SceneCacheView
+{
+	const T* data = nullptr;
+	nbUint64 size = 0u;
+
+	nbBool empty() const { return size == 0u; }
+	const T& operator[](nbUint64 idx) const { return data[idx]; }
+
+	const T* begin() const { return data; }
+	const T* end() const { return data + size; }
+};
+
+// Writes the imported data of a scene so the next load maps it instead of importing the source assets again.
+// Sections are arrays of trivially copyable elements, identified by their type and the index of their mesh.
+class SceneCacheWriter
+{
+public:
+	// The data is read by write(), it must stay alive until then.
+	void addSection(SceneCacheSection type, nbUint32 meshIdx, const void* data, nbUint32 elementSize, nbUint64 nbElements);
+
+	template <typename T>
+	void addSection(SceneCacheSection type, nbUint32 meshIdx, const T* data, nbUint64 nbElements);
+
+	template <typename T, typename Allocator>
+	void addSection(SceneCacheSection type, nbUint32 meshIdx, const std::vector<T, Allocator>& data);
+
+	nbBool write(const std::string& path, nbUint64 sourceKey) const;
+
+private:
+	struct PendingSection
+	{
+		SceneCacheSection type;
+		nbUint32 meshIdx;
+		const void* data;
+		nbUint32 elementSize;
+		nbUint64 nbElements;
+	};
+
+	std::vector<PendingSection> m_sections;
+};
+
+template <typename T>
+void SceneCacheWriter::addSection(SceneCacheSection type, nbUint32 meshIdx, const T* data, nbUint64 nbElements)
+{
+	static_assert(std::is_trivially_copyable<T>::value, "Scene cache sections are copied byte for byte");
+	addSection(type, meshIdx, data, (nbUint32)sizeof(T), nbElements);
+}
+
+template <typename T, typename Allocator>
+void SceneCacheWriter::addSection(SceneCacheSection type, nbUint32 meshIdx, const std::vector<T, Allocator>& data)
+{
+	addSection(type, meshIdx, data.data(), data.size());
+}
+
+// Memory mapped scene cache file. Nothing is copied on load, sections are read in place.
+//
+// File layout:
+//	FileHeader
+//	SectionEntry[nbSections], sorted by type then mesh index
+//	Section data, each section starting on a 64 bytes boundary
+class SceneCache
+{
+public:
+	// Nullptr if the file is missing, from another format version or from other source assets.
+	static std::unique_ptr<SceneCache> open(const std::string& path, nbUint64 sourceKey);
+
+	// Changes with the source path, size and modification time.
+	static nbUint64 computeSourceKey(const std::string& sourcePath);
+
+	static std::string getCachePath(const std::string& sourcePath);
+
+	// Empty if the section is missing or was written with another element size.
+	template <typename T>
+	SceneCacheView<T> getSection(SceneCacheSection type, nbUint32 meshIdx = 0u) const;
+
+	nbUint32 getNbMeshes() const;
+
+private:
+	friend class SceneCacheWriter;
+
+	static const nbUint32 s_magic;
+	static const nbUint32 s_version;
+	static const nbUint64 s_sectionAlignment;
+
+	struct FileHeader
+	{
+		nbUint32 magic;
+		nbUint32 version;
+		nbUint64 sourceKey;
+		nbUint32 nbSections;
+		nbUint32 nbMeshes;
+	};
+
+	struct SectionEntry
+	{
+		SceneCacheSection type;
+		nbUint32 meshIdx;
+		nbUint32 elementSize;
+		nbUint32 padding;
+		nbUint64 offset;
+		nbUint64 nbElements;
+	};
+
+	const SectionEntry* findSection(SceneCacheSection type, nbUint32 meshIdx) const;
+
+	MappedFile m_file;
+	const FileHeader* m_header = nullptr;
+	const SectionEntry* m_sections = nullptr;
+};
+
+template <typename T>
+SceneCacheView<T> SceneCache::getSection(SceneCacheSection type, nbUint32 meshIdx) const
+{
+	SceneCacheView<T> view;
+
+	const SectionEntry* section = findSection(type, meshIdx);
+	if (section && section->elementSize == sizeof(T))
+	{
+		view.data = reinterpret_cast<const T*>(m_file.getData() + section->offset);
+		view.size = section->nbElements;
+	}
+
+	return view;
+}
+
+inline nbUint32 SceneCache::getNbMeshes() const
+{
+	return m_header->nbMeshes;
+}
+}}}
@@ -0,0 +1,66 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include <limits>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Accelerator
+{
+// Axis aligned bounding box. Empty boxes have min above max.
+struct Aabb
+{
+	glm::vec3 min = glm::vec3(std::numeric_limits<nbFloat32>::max());
+	glm::vec3 max = glm::vec3(-std::numeric_limits<nbFloat32>::max());
+
+	void extend(const glm::vec3& point);
+	void extend(const Aabb& box);
+
+	nbBool isEmpty() const;
+	glm::vec3 getCenter() const;
+	glm::vec3 getExtent() const;
+
+	// Half the surface area, enough for SAH ratios.
+	nbFloat32 getHalfArea() const;
+};
+
+inline void Aabb::extend(const glm::vec3& point)
+{
+	min = glm::min(min, point);
+	max = glm::max(max, point);
+}
+
+inline void Aabb::extend(const Aabb& box)
+{
+	min = glm::min(min, box.min);
+	max = glm::max(max, box.max);
+}
+
+inline nbBool Aabb::isEmpty() const
+{
+	return min.x > max.x || min.y > max.y || min.z > max.z;
+}
+
+inline glm::vec3 Aabb::getCenter() const
+{
+	return (min + max) * 0.5f;
+}
+
+inline glm::vec3 Aabb::getExtent() const
+{
+	return max - min;
+}
+
+inline nbFloat32 Aabb::getHalfArea() const
+{
+	if (isEmpty())
+		return 0.0f;
+
+	const glm::vec3 extent = getExtent();
+	return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+}
+}}}}
\ No newline at end of file
@@ -0,0 +1,243 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+// Standalone executable, not part of the Core library. Link it with Accelerator/Bvh.cpp, Cache/SceneCache.cpp and Cache/MappedFile.cpp.
+// Builds a bvh of each node layout over random triangles, then reports the build, the tree and the traversal speed
+// of random rays and of camera like coherent rays, single and streamed, ray by ray and as packets.
+// Usage: AcceleratorBenchmark [nbTriangles] [nbRays]
+
+#include "stdafx.h"
+#include "../Bvh.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace Graphics::Renderer::Offline::Accelerator;
+
+namespace
+{
+	const nbFloat32 SceneSize = 100.0f;
+	const nbFloat32 TriangleSize = 0.8f;
+
+	struct RaySet
+	{
+		std::vector<nbFloat32> originX, originY, originZ;
+		std::vector<nbFloat32> directionX, directionY, directionZ;
+		std::vector<nbFloat32> tMax;
+
+		void add(const glm::vec3& origin, const glm::vec3& direction)
+		{
+			originX.push_back(origin.x);
+			originY.push_back(origin.y);
+			originZ.push_back(origin.z);
+			directionX.push_back(direction.x);
+			directionY.push_back(direction.y);
+			directionZ.push_back(direction.z);
+			tMax.push_back(1e30f);
+		}
+
+		nbUint32 size() const
+		{
+			return (nbUint32)tMax.size();
+		}
+
+		glm::vec3 getOrigin(nbUint32 i) const
+		{
+			return glm::vec3(originX[i], originY[i], originZ[i]);
+		}
+
+		glm::vec3 getDirection(nbUint32 i) const
+		{
+			return glm::vec3(directionX[i], directionY[i], directionZ[i]);
+		}
+
+		BvhRayStream getStream() const
+		{
+			BvhRayStream stream;
+			stream.originX = originX.data();
+			stream.originY = originY.data();
+			stream.originZ = originZ.data();
+			stream.directionX = directionX.data();
+			stream.directionY = directionY.data();
+			stream.directionZ = directionZ.data();
+			stream.tMax = tMax.data();
+			stream.size = size();
+
+			return stream;
+		}
+	};
+
+	template <typename Func>
+	nbFloat64 measureSeconds(const Func& func)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		func();
+		return std::chrono::duration<nbFloat64>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	void generateTriangles(nbUint32 nbTriangles, std::mt19937& generator, std::vector<glm::vec3>& vertices, std::vector<nbUint32>& indices)
+	{
+		std::uniform_real_distribution<nbFloat32> unit(0.0f, 1.0f);
+
+		for (nbUint32 i = 0u; i < nbTriangles; ++i)
+		{
+			const glm::vec3 center(unit(generator) * SceneSize, unit(generator) * SceneSize, unit(generator) * SceneSize);
+
+			for (nbUint32 k = 0u; k < 3u; ++k)
+			{
+				const glm::vec3 offset(unit(generator) - 0.5f, unit(generator) - 0.5f, unit(generator) - 0.5f);
+
+				indices.push_back((nbUint32)vertices.size());
+				vertices.push_back(center + offset * TriangleSize);
+			}
+		}
+	}
+
+	// Origins and directions spread over the whole scene.
+	RaySet generateRandomRays(nbUint32 nbRays, std::mt19937& generator)
+	{
+		std::uniform_real_distribution<nbFloat32> unit(0.0f, 1.0f);
+
+		RaySet rays;
+		for (nbUint32 i = 0u; i < nbRays; ++i)
+		{
+			const glm::vec3 origin(unit(generator) * SceneSize, unit(generator) * SceneSize, unit(generator) * SceneSize);
+			const glm::vec3 direction(unit(generator) - 0.5f, unit(generator) - 0.5f, unit(generator) - 0.5f);
+
+			rays.add(origin, glm::normalize(direction));
+		}
+
+		return rays;
+	}
+
+	// Pinhole camera outside the scene looking at it, rays in scanline order.
+	RaySet generateCameraRays(nbUint32 nbRays)
+	{
+		const nbUint32 resolution = std::max(1u, (nbUint32)std::sqrt((nbFloat32)nbRays));
+		const glm::vec3 origin(-SceneSize, SceneSize * 0.5f, SceneSize * 0.5f);
+
+		RaySet rays;
+		for (nbUint32 y = 0u; y < resolution; ++y)
+		{
+			for (nbUint32 x = 0u; x < resolution; ++x)
+			{
+				const glm::vec3 target(SceneSize, (x + 0.5f) / resolution * SceneSize, (y + 0.5f) / resolution * SceneSize);
+				rays.add(origin, glm::normalize(target - origin));
+			}
+		}
+
+		return rays;
+	}
+
+	void printTraversal(const char* name, nbUint32 nbRays, nbFloat64 seconds, const BvhTraversalStats& stats)
+	{
+		std::printf("    %-28s %8.2f Mrays/s  %7.1f node visits/ray  %6.1f packet tests/ray\n", name,
+			nbRays / seconds * 1e-6, (nbFloat64)stats.nbNodeVisits / nbRays, (nbFloat64)stats.nbPacketTests / nbRays);
+	}
+
+	void benchmarkRays(const Bvh& bvh, const char* name, const RaySet& rays)
+	{
+		const nbUint32 nbRays = rays.size();
+		std::printf("  %s rays, %u\n", name, nbRays);
+
+		std::vector<BvhHit> hits(nbRays);
+		std::vector<nbUint8> found(nbRays);
+		std::vector<nbFloat32> occlusions(nbRays);
+
+		BvhTraversalStats stats;
+		nbFloat64 seconds = measureSeconds([&]()
+		{
+			for (nbUint32 i = 0u; i < nbRays; ++i)
+				found[i] = bvh.intersect(rays.getOrigin(i), rays.getDirection(i), rays.tMax[i], hits[i], &stats);
+		});
+		printTraversal("intersect", nbRays, seconds, stats);
+
+		stats = BvhTraversalStats();
+		seconds = measureSeconds([&]()
+		{
+			for (nbUint32 i = 0u; i < nbRays; ++i)
+				occlusions[i] = bvh.occlusion(rays.getOrigin(i), rays.getDirection(i), rays.tMax[i], &stats);
+		});
+		printTraversal("occlusion", nbRays, seconds, stats);
+
+		// Stream queries in both walks, checked against the single ray results.
+		std::vector<nbUint8> streamHit(nbRays);
+		std::vector<nbFloat32> streamT(nbRays), streamU(nbRays), streamV(nbRays), streamOcclusions(nbRays);
+		std::vector<nbUint32> streamPrimIdx(nbRays);
+
+		BvhHitStream hitStream;
+		hitStream.hit = streamHit.data();
+		hitStream.t = streamT.data();
+		hitStream.u = streamU.data();
+		hitStream.v = streamV.data();
+		hitStream.primIdx = streamPrimIdx.data();
+
+		BvhRayStream rayStream = rays.getStream();
+
+		for (const nbBool packetWalk : { false, true })
+		{
+			rayStream.packetWalk = packetWalk;
+
+			stats = BvhTraversalStats();
+			seconds = measureSeconds([&]() { bvh.intersect(rayStream, hitStream, &stats); });
+			printTraversal(packetWalk ? "intersect stream, packets" : "intersect stream", nbRays, seconds, stats);
+
+			stats = BvhTraversalStats();
+			seconds = measureSeconds([&]() { bvh.occlusion(rayStream, streamOcclusions.data(), &stats); });
+			printTraversal(packetWalk ? "occlusion stream, packets" : "occlusion stream", nbRays, seconds, stats);
+
+			nbUint32 nbMismatches = 0u;
+			for (nbUint32 i = 0u; i < nbRays; ++i)
+			{
+				if (!!streamHit[i] != !!found[i] || (found[i] && (streamT[i] != hits[i].t || streamPrimIdx[i] != hits[i].primIdx)))
+					++nbMismatches;
+				if (streamOcclusions[i] != occlusions[i])
+					++nbMismatches;
+			}
+
+			std::printf("    stream mismatches %u\n", nbMismatches);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const nbUint32 nbTriangles = argc > 1 ? (nbUint32)std::atoi(argv[1]) : 300000u;
+	const nbUint32 nbRays = argc > 2 ? (nbUint32)std::atoi(argv[2]) : 200000u;
+
+	std::mt19937 generator(42u);
+
+	std::vector<glm::vec3> vertices;
+	std::vector<nbUint32> indices;
+	generateTriangles(nbTriangles, generator, vertices, indices);
+
+	const RaySet randomRays = generateRandomRays(nbRays, generator);
+	const RaySet cameraRays = generateCameraRays(nbRays);
+
+	std::printf("%u triangles, %u wide nodes\n", nbTriangles, BvhNode::Width);
+
+	for (const BvhNodeLayout layout : { BvhNodeLayout::Full, BvhNodeLayout::Compressed })
+	{
+		BvhSettings settings;
+		settings.m_nodeLayout = layout;
+
+		Bvh bvh;
+		bvh.build(vertices, indices, settings);
+
+		const BvhStats& stats = bvh.getStats();
+		std::printf("%s layout\n", layout == BvhNodeLayout::Full ? "Full" : "Compressed");
+		std::printf("  build %.3f s, %u nodes, %u leaves, depth %u, %.2f MB of nodes, sah cost %.2f\n", stats.buildSeconds,
+			stats.nbNodes, stats.nbLeaves, stats.maxDepth, stats.nodeBytes / (1024.0 * 1024.0), stats.sahCost);
+
+		benchmarkRays(bvh, "Random", randomRays);
+		benchmarkRays(bvh, "Camera", cameraRays);
+	}
+
+	return 0;
+}
\ No newline at end of file
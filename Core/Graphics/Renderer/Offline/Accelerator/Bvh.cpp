@@ -0,0 +1,1126 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#include "stdafx.h"
+#include "Bvh.h"
+#include "BvhTraversal.h"
+#include "tbb/tbb.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Accelerator
+{
+	namespace
+	{
+		constexpr nbUint32 MaxNbBins = 32u;
+		constexpr nbUint32 InvalidIdx = 0xffffffffu;
+
+		// Spread the 10 low bits of value so there are two zero bits between each of them.
+		nbUint32 expandBits(nbUint32 value)
+		{
+			nbUint32 x = value & 0x3ffu;
+			x = (x | (x << 16u)) & 0x30000ffu;
+			x = (x | (x << 8u)) & 0x300f00fu;
+			x = (x | (x << 4u)) & 0x30c30c3u;
+			x = (x | (x << 2u)) & 0x9249249u;
+			return x;
+		}
+
+		nbUint32 getNbPackets(nbUint32 nbTriangles)
+		{
+			return (nbTriangles + BvhNode::Width - 1u) / BvhNode::Width;
+		}
+
+		// Levels of median splits below a range of nbTriangles before its leaves.
+		nbUint32 getMedianDepth(nbUint32 nbTriangles)
+		{
+			nbUint32 depth = 0u;
+			for (nbUint32 nbPackets = getNbPackets(nbTriangles); nbPackets > 1u; nbPackets = (nbPackets + 1u) / 2u)
+				++depth;
+
+			return depth;
+		}
+
+		Aabb getLaneBounds(const BvhNode& node, nbUint32 lane)
+		{
+			Aabb bounds;
+			bounds.min = glm::vec3(node.minX[lane], node.minY[lane], node.minZ[lane]);
+			bounds.max = glm::vec3(node.maxX[lane], node.maxY[lane], node.maxZ[lane]);
+			return bounds;
+		}
+
+		Aabb getLaneBounds(const BvhCompressedNode& node, nbUint32 lane)
+		{
+			const glm::vec3 origin(node.origin[0], node.origin[1], node.origin[2]);
+			const glm::vec3 scale(getCompressedScale(node.exponents[0]), getCompressedScale(node.exponents[1]), getCompressedScale(node.exponents[2]));
+
+			Aabb bounds;
+			bounds.min = origin + glm::vec3(node.qMinX[lane], node.qMinY[lane], node.qMinZ[lane]) * scale;
+			bounds.max = origin + glm::vec3(node.qMaxX[lane], node.qMaxY[lane], node.qMaxZ[lane]) * scale;
+			return bounds;
+		}
+
+		// Quantizes the children bounds of node in a frame covering them all.
+		BvhCompressedNode compressNode(const BvhNode& node)
+		{
+			Aabb frame;
+			for (nbUint32 lane = 0u; lane < BvhNode::Width; ++lane)
+			{
+				if (node.children[lane] != BvhNode::EmptyChild)
+					frame.extend(getLaneBounds(node, lane));
+			}
+
+			BvhCompressedNode dst = {};
+			if (frame.isEmpty())
+				frame.min = frame.max = glm::vec3(0.0f);
+
+			nbUint8 qMins[3][BvhNode::Width] = {};
+			nbUint8 qMaxs[3][BvhNode::Width] = {};
+
+			for (nbUint32 axis = 0u; axis < 3u; ++axis)
+			{
+				const nbFloat32 origin = frame.min[axis];
+				const nbFloat32 extent = frame.max[axis] - frame.min[axis];
+
+				// Smallest power of two mapping the extent on 254 steps, the last one is left for the outward margin.
+				nbInt32 exponent = extent > 0.0f ? (nbInt32)std::ceil(std::log2(extent / 254.0f)) : -126;
+				exponent = std::max(-126, std::min(exponent, 127));
+
+				while (exponent < 127 && origin + 254.0f * std::ldexp(1.0f, exponent) < frame.max[axis])
+					++exponent;
+
+				dst.origin[axis] = origin;
+				dst.exponents[axis] = (nbUint8)(exponent + 127);
+
+				const nbFloat32 scale = getCompressedScale(dst.exponents[axis]);
+
+				for (nbUint32 lane = 0u; lane < BvhNode::Width; ++lane)
+				{
+					if (node.children[lane] == BvhNode::EmptyChild)
+						continue;
+
+					const Aabb bounds = getLaneBounds(node, lane);
+
+					// Rounding of the division may still move a bound inward by one step, fixed here.
+					nbFloat32 qMin = std::max(0.0f, std::floor((bounds.min[axis] - origin) / scale));
+					while (qMin > 0.0f && origin + qMin * scale > bounds.min[axis])
+						qMin -= 1.0f;
+
+					nbFloat32 qMax = std::min(254.0f, std::ceil((bounds.max[axis] - origin) / scale));
+					while (qMax < 254.0f && origin + qMax * scale < bounds.max[axis])
+						qMax += 1.0f;
+
+					// One more step outward, so a decoding rounded otherwise than here (e.g. contracted to an fma) cannot
+					// shrink the box. Step 0 needs none, it decodes to the origin.
+					qMin = std::max(0.0f, qMin - 1.0f);
+					qMax += 1.0f;
+
+					qMins[axis][lane] = (nbUint8)qMin;
+					qMaxs[axis][lane] = (nbUint8)qMax;
+				}
+			}
+
+			for (nbUint32 lane = 0u; lane < BvhNode::Width; ++lane)
+			{
+				dst.qMinX[lane] = qMins[0][lane];
+				dst.qMinY[lane] = qMins[1][lane];
+				dst.qMinZ[lane] = qMins[2][lane];
+				dst.qMaxX[lane] = qMaxs[0][lane];
+				dst.qMaxY[lane] = qMaxs[1][lane];
+				dst.qMaxZ[lane] = qMaxs[2][lane];
+				dst.children[lane] = node.children[lane];
+			}
+
+			return dst;
+		}
+
+		template <typename NodeViewT, typename PacketViewT>
+		nbBool checkChildren(const NodeViewT& nodes, const PacketViewT& packets)
+		{
+			for (const auto& node : nodes)
+			{
+				for (nbUint32 lane = 0u; lane < BvhNode::Width; ++lane)
+				{
+					const nbUint32 child = node.children[lane];
+					if (child == BvhNode::EmptyChild)
+						continue;
+
+					if ((child & BvhNode::LeafFlag) ? (child & ~BvhNode::LeafFlag) >= packets.size : child >= nodes.size)
+						return false;
+				}
+			}
+
+			return true;
+		}
+
+		// The traversal stacks hold trees of BvhMaxDepth levels. A tree visits each node once, shared nodes and cycles are rejected.
+		template <typename NodeViewT>
+		nbBool checkDepth(const NodeViewT& nodes)
+		{
+			if (nodes.empty())
+				return true;
+
+			std::vector<std::pair<nbUint32, nbUint32>> stack;
+			stack.emplace_back(0u, 1u);
+			nbUint64 nbVisits = 0u;
+
+			while (!stack.empty())
+			{
+				const auto entry = stack.back();
+				stack.pop_back();
+
+				if (entry.second > BvhMaxDepth || ++nbVisits > nodes.size)
+					return false;
+
+				const auto& node = nodes[entry.first];
+				for (nbUint32 lane = 0u; lane < BvhNode::Width; ++lane)
+				{
+					const nbUint32 child = node.children[lane];
+					if (child != BvhNode::EmptyChild && !(child & BvhNode::LeafFlag))
+						stack.emplace_back(child, entry.second + 1u);
+				}
+			}
+
+			return true;
+		}
+
+		struct BuildNode
+		{
+			Aabb bounds;
+			nbUint32 begin;
+			nbUint32 count;
+
+			// InvalidIdx for leaves.
+			nbUint32 left;
+			nbUint32 right;
+		};
+
+		struct RangeBounds
+		{
+			Aabb bounds;
+			Aabb centroidBounds;
+
+			void join(const RangeBounds& other)
+			{
+				bounds.extend(other.bounds);
+				centroidBounds.extend(other.centroidBounds);
+			}
+		};
+
+		struct Bins
+		{
+			Aabb bounds[3][MaxNbBins];
+			nbUint32 counts[3][MaxNbBins] = {};
+
+			void join(const Bins& other)
+			{
+				for (nbUint32 axis = 0u; axis < 3u; ++axis)
+				{
+					for (nbUint32 i = 0u; i < MaxNbBins; ++i)
+					{
+						bounds[axis][i].extend(other.bounds[axis][i]);
+						counts[axis][i] += other.counts[axis][i];
+					}
+				}
+			}
+		};
+
+		// Binary tree build. Nodes are preallocated, a tree whose leaves are not empty has at most 2n - 1 nodes.
+		// Leaves are at most BvhMaxDepth levels down, so the wide tree built from it fits the traversal stacks.
+		class BinaryBuilder
+		{
+		public:
+			BinaryBuilder(const BvhSettings& settings, const std::vector<Aabb>& primBounds, const std::vector<glm::vec3>& centroids,
+				std::vector<nbUint32>& primIds, std::vector<BuildNode>& nodes)
+			: m_settings(settings)
+			, m_primBounds(primBounds)
+			, m_centroids(centroids)
+			, m_primIds(primIds)
+			, m_nodes(nodes)
+			, m_nbNodes(1u)
+			{
+				m_nbBins = std::max(2u, std::min(m_settings.m_nbBins, MaxNbBins));
+			}
+
+			void build(nbUint32 nodeIdx, nbUint32 depth)
+			{
+				BuildNode& node = m_nodes[nodeIdx];
+				node.left = node.right = InvalidIdx;
+
+				const RangeBounds rangeBounds = computeRangeBounds(node.begin, node.count);
+				node.bounds = rangeBounds.bounds;
+
+				// A leaf is a single triangle packet.
+				if (node.count <= BvhNode::Width)
+					return;
+
+				// Degenerate inputs make deep SAH trees. Median splits keep the depth left at its minimum once it reaches the limit.
+				const nbUint32 splitIdx = depth + getMedianDepth(node.count) < BvhMaxDepth ?
+					split(node, rangeBounds.centroidBounds) : node.begin + node.count / 2u;
+
+				node.left = m_nbNodes.fetch_add(2u);
+				node.right = node.left + 1u;
+
+				BuildNode& left = m_nodes[node.left];
+				left.begin = node.begin;
+				left.count = splitIdx - node.begin;
+
+				BuildNode& right = m_nodes[node.right];
+				right.begin = splitIdx;
+				right.count = node.begin + node.count - splitIdx;
+
+				if (node.count > m_settings.m_parallelThreshold)
+				{
+					const nbUint32 leftIdx = node.left;
+					const nbUint32 rightIdx = node.right;
+
+					tbb::parallel_invoke([&]() { build(leftIdx, depth + 1u); }, [&]() { build(rightIdx, depth + 1u); });
+				}
+				else
+				{
+					build(node.left, depth + 1u);
+					build(node.right, depth + 1u);
+				}
+			}
+
+			nbUint32 getNbNodes() const
+			{
+				return m_nbNodes.load();
+			}
+
+		private:
+			RangeBounds computeRangeBounds(nbUint32 begin, nbUint32 count) const
+			{
+				auto accumulate = [&](nbUint32 first, nbUint32 last, RangeBounds dst)
+				{
+					for (nbUint32 i = first; i < last; ++i)
+					{
+						const nbUint32 primIdx = m_primIds[i];
+						dst.bounds.extend(m_primBounds[primIdx]);
+						dst.centroidBounds.extend(m_centroids[primIdx]);
+					}
+
+					return dst;
+				};
+
+				if (count <= m_settings.m_parallelThreshold)
+					return accumulate(begin, begin + count, RangeBounds());
+
+				return tbb::parallel_reduce(tbb::blocked_range<nbUint32>(begin, begin + count), RangeBounds(),
+					[&](const tbb::blocked_range<nbUint32>& range, RangeBounds dst)
+				{
+					return accumulate(range.begin(), range.end(), dst);
+				},
+					[](RangeBounds a, const RangeBounds& b)
+				{
+					a.join(b);
+					return a;
+				});
+			}
+
+			// Returns the first index of the right child.
+			nbUint32 split(const BuildNode& node, const Aabb& centroidBounds)
+			{
+				const nbUint32 begin = node.begin;
+				const nbUint32 end = node.begin + node.count;
+
+				// Identical centroids: the range is in morton order, cut it in the middle.
+				const glm::vec3 extent = centroidBounds.getExtent();
+				if (std::max(extent.x, std::max(extent.y, extent.z)) <= 0.0f)
+					return begin + node.count / 2u;
+
+				glm::vec3 scale;
+				for (nbUint32 axis = 0u; axis < 3u; ++axis)
+					scale[axis] = extent[axis] > 0.0f ? m_nbBins * 0.9999f / extent[axis] : 0.0f;
+
+				auto getBin = [&](nbUint32 primIdx, nbUint32 axis)
+				{
+					const nbFloat32 offset = (m_centroids[primIdx][axis] - centroidBounds.min[axis]) * scale[axis];
+					return std::min(m_nbBins - 1u, (nbUint32)offset);
+				};
+
+				auto fillBins = [&](nbUint32 first, nbUint32 last, Bins& dst)
+				{
+					for (nbUint32 i = first; i < last; ++i)
+					{
+						const nbUint32 primIdx = m_primIds[i];
+						for (nbUint32 axis = 0u; axis < 3u; ++axis)
+						{
+							const nbUint32 bin = getBin(primIdx, axis);
+							dst.bounds[axis][bin].extend(m_primBounds[primIdx]);
+							++dst.counts[axis][bin];
+						}
+					}
+				};
+
+				Bins bins;
+				if (node.count <= m_settings.m_parallelThreshold)
+				{
+					fillBins(begin, end, bins);
+				}
+				else
+				{
+					tbb::combinable<Bins> threadBins;
+					tbb::parallel_for(tbb::blocked_range<nbUint32>(begin, end), [&](const tbb::blocked_range<nbUint32>& range)
+					{
+						fillBins(range.begin(), range.end(), threadBins.local());
+					});
+
+					threadBins.combine_each([&](const Bins& local) { bins.join(local); });
+				}
+
+				// Cost of a side is its area times its number of packets.
+				nbFloat32 bestCost = std::numeric_limits<nbFloat32>::max();
+				nbUint32 bestAxis = 0u;
+				nbUint32 bestBin = 0u;
+
+				for (nbUint32 axis = 0u; axis < 3u; ++axis)
+				{
+					if (scale[axis] == 0.0f)
+						continue;
+
+					nbFloat32 rightCosts[MaxNbBins];
+					Aabb rightBounds;
+					nbUint32 rightCount = 0u;
+
+					for (nbUint32 i = m_nbBins - 1u; i > 0u; --i)
+					{
+						rightBounds.extend(bins.bounds[axis][i]);
+						rightCount += bins.counts[axis][i];
+						rightCosts[i - 1u] = rightBounds.getHalfArea() * getNbPackets(rightCount);
+					}
+
+					Aabb leftBounds;
+					nbUint32 leftCount = 0u;
+
+					for (nbUint32 i = 0u; i < m_nbBins - 1u; ++i)
+					{
+						leftBounds.extend(bins.bounds[axis][i]);
+						leftCount += bins.counts[axis][i];
+
+						if (!leftCount || leftCount == node.count)
+							continue;
+
+						const nbFloat32 cost = leftBounds.getHalfArea() * getNbPackets(leftCount) + rightCosts[i];
+						if (cost < bestCost)
+						{
+							bestCost = cost;
+							bestAxis = axis;
+							bestBin = i;
+						}
+					}
+				}
+
+				if (bestCost == std::numeric_limits<nbFloat32>::max())
+					return begin + node.count / 2u;
+
+				// Stable to keep the morton order on both sides.
+				auto it = std::stable_partition(m_primIds.begin() + begin, m_primIds.begin() + end, [&](nbUint32 primIdx)
+				{
+					return getBin(primIdx, bestAxis) <= bestBin;
+				});
+
+				return (nbUint32)(it - m_primIds.begin());
+			}
+
+			const BvhSettings& m_settings;
+			const std::vector<Aabb>& m_primBounds;
+			const std::vector<glm::vec3>& m_centroids;
+			std::vector<nbUint32>& m_primIds;
+			std::vector<BuildNode>& m_nodes;
+
+			nbUint32 m_nbBins;
+			std::atomic<nbUint32> m_nbNodes;
+		};
+
+		// Wide tree build. Each wide node opens the binary nodes with the largest area until its lanes are full.
+		class WideBuilder
+		{
+		public:
+			WideBuilder(const BvhSettings& settings, const std::vector<BuildNode>& buildNodes, const std::vector<nbUint32>& primIds,
+				const std::vector<glm::vec3>& vertices, const std::vector<nbUint32>& indices,
+				Bvh::NodeArray& nodes, Bvh::PacketArray& packets, BvhStats& stats)
+			: m_settings(settings)
+			, m_buildNodes(buildNodes)
+			, m_primIds(primIds)
+			, m_vertices(vertices)
+			, m_indices(indices)
+			, m_nodes(nodes)
+			, m_packets(packets)
+			, m_stats(stats)
+			{
+				m_invRootArea = 1.0f / std::max(buildNodes[0].bounds.getHalfArea(), std::numeric_limits<nbFloat32>::min());
+			}
+
+			nbUint32 build(nbUint32 buildIdx, nbUint32 depth)
+			{
+				const nbUint32 nodeIdx = (nbUint32)m_nodes.size();
+				m_nodes.emplace_back();
+
+				m_stats.maxDepth = std::max(m_stats.maxDepth, depth);
+				m_stats.sahCost += m_settings.m_nodeCost * m_buildNodes[buildIdx].bounds.getHalfArea() * m_invRootArea;
+
+				nbUint32 lanes[BvhNode::Width];
+				nbUint32 nbLanes = 0u;
+
+				if (isLeaf(buildIdx))
+				{
+					lanes[nbLanes++] = buildIdx;
+				}
+				else
+				{
+					lanes[nbLanes++] = m_buildNodes[buildIdx].left;
+					lanes[nbLanes++] = m_buildNodes[buildIdx].right;
+				}
+
+				while (nbLanes < BvhNode::Width)
+				{
+					nbUint32 bestLane = InvalidIdx;
+					nbFloat32 bestArea = -1.0f;
+
+					for (nbUint32 i = 0u; i < nbLanes; ++i)
+					{
+						const nbFloat32 area = m_buildNodes[lanes[i]].bounds.getHalfArea();
+						if (!isLeaf(lanes[i]) && area > bestArea)
+						{
+							bestArea = area;
+							bestLane = i;
+						}
+					}
+
+					if (bestLane == InvalidIdx)
+						break;
+
+					// The right child goes next to the left one, so lanes stay ordered from the low side of the splits.
+					const BuildNode& opened = m_buildNodes[lanes[bestLane]];
+					for (nbUint32 i = nbLanes++; i > bestLane + 1u; --i)
+						lanes[i] = lanes[i - 1u];
+
+					lanes[bestLane] = opened.left;
+					lanes[bestLane + 1u] = opened.right;
+				}
+
+				for (nbUint32 i = 0u; i < BvhNode::Width; ++i)
+				{
+					BvhNode& node = m_nodes[nodeIdx];
+
+					if (i >= nbLanes)
+					{
+						setLane(node, i, Aabb(), BvhNode::EmptyChild);
+						continue;
+					}
+
+					const BuildNode& child = m_buildNodes[lanes[i]];
+					if (isLeaf(lanes[i]))
+					{
+						setLane(node, i, child.bounds, addPacket(child) | BvhNode::LeafFlag);
+
+						++m_stats.nbLeaves;
+						m_stats.sahCost += m_settings.m_packetCost * child.bounds.getHalfArea() * m_invRootArea;
+					}
+					else
+					{
+						// The node array may grow, the lane is written once the child exists.
+						const nbUint32 childIdx = build(lanes[i], depth + 1u);
+						setLane(m_nodes[nodeIdx], i, child.bounds, childIdx);
+					}
+				}
+
+				return nodeIdx;
+			}
+
+		private:
+			nbBool isLeaf(nbUint32 buildIdx) const
+			{
+				return m_buildNodes[buildIdx].left == InvalidIdx;
+			}
+
+			static void setLane(BvhNode& node, nbUint32 lane, const Aabb& bounds, nbUint32 child)
+			{
+				node.minX[lane] = bounds.min.x;
+				node.minY[lane] = bounds.min.y;
+				node.minZ[lane] = bounds.min.z;
+				node.maxX[lane] = bounds.max.x;
+				node.maxY[lane] = bounds.max.y;
+				node.maxZ[lane] = bounds.max.z;
+				node.children[lane] = child;
+			}
+
+			nbUint32 addPacket(const BuildNode& leaf)
+			{
+				const nbUint32 packetIdx = (nbUint32)m_packets.size();
+				m_packets.emplace_back();
+
+				BvhTrianglePacket& packet = m_packets.back();
+				for (nbUint32 lane = 0u; lane < BvhNode::Width; ++lane)
+				{
+					glm::vec3 v0(0.0f), e1(0.0f), e2(0.0f);
+					nbUint32 primIdx = BvhNode::EmptyChild;
+
+					if (lane < leaf.count)
+					{
+						primIdx = m_primIds[leaf.begin + lane];
+						v0 = m_vertices[m_indices[primIdx * 3u]];
+						e1 = m_vertices[m_indices[primIdx * 3u + 1u]] - v0;
+						e2 = m_vertices[m_indices[primIdx * 3u + 2u]] - v0;
+					}
+
+					packet.v0x[lane] = v0.x;
+					packet.v0y[lane] = v0.y;
+					packet.v0z[lane] = v0.z;
+					packet.e1x[lane] = e1.x;
+					packet.e1y[lane] = e1.y;
+					packet.e1z[lane] = e1.z;
+					packet.e2x[lane] = e2.x;
+					packet.e2y[lane] = e2.y;
+					packet.e2z[lane] = e2.z;
+					packet.primIdx[lane] = primIdx;
+				}
+
+				return packetIdx;
+			}
+
+			const BvhSettings& m_settings;
+			const std::vector<BuildNode>& m_buildNodes;
+			const std::vector<nbUint32>& m_primIds;
+			const std::vector<glm::vec3>& m_vertices;
+			const std::vector<nbUint32>& m_indices;
+
+			Bvh::NodeArray& m_nodes;
+			Bvh::PacketArray& m_packets;
+			BvhStats& m_stats;
+
+			nbFloat32 m_invRootArea;
+		};
+	}
+
+	void Bvh::build(const std::vector<glm::vec3>& vertices, const std::vector<nbUint32>& indices, const BvhSettings& settings)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+
+		m_nodes.clear();
+		m_compressedNodes.clear();
+		m_packets.clear();
+		m_opacities.clear();
+		m_bounds = Aabb();
+		m_stats = BvhStats();
+
+		const nbUint32 nbTriangles = (nbUint32)(indices.size() / 3u);
+		if (!nbTriangles)
+			return;
+
+		std::vector<Aabb> primBounds(nbTriangles);
+		std::vector<glm::vec3> centroids(nbTriangles);
+
+		tbb::parallel_for(nbUint32(0), nbTriangles, [&](nbUint32 i)
+		{
+			Aabb& bounds = primBounds[i];
+			bounds.extend(vertices[indices[i * 3u]]);
+			bounds.extend(vertices[indices[i * 3u + 1u]]);
+			bounds.extend(vertices[indices[i * 3u + 2u]]);
+
+			centroids[i] = bounds.getCenter();
+		});
+
+		// Morton order of the centroids.
+		Aabb centroidBounds;
+		for (const glm::vec3& centroid : centroids)
+			centroidBounds.extend(centroid);
+
+		const glm::vec3 extent = centroidBounds.getExtent();
+		const glm::vec3 scale(extent.x > 0.0f ? 1023.0f / extent.x : 0.0f,
+			extent.y > 0.0f ? 1023.0f / extent.y : 0.0f,
+			extent.z > 0.0f ? 1023.0f / extent.z : 0.0f);
+
+		std::vector<nbUint64> keys(nbTriangles);
+		tbb::parallel_for(nbUint32(0), nbTriangles, [&](nbUint32 i)
+		{
+			const glm::uvec3 cell((centroids[i] - centroidBounds.min) * scale);
+			const nbUint32 code = expandBits(cell.x) | (expandBits(cell.y) << 1u) | (expandBits(cell.z) << 2u);
+
+			// Index in the low bits keeps the order deterministic.
+			keys[i] = ((nbUint64)code << 32u) | i;
+		});
+
+		tbb::parallel_sort(keys.begin(), keys.end());
+
+		std::vector<nbUint32> primIds(nbTriangles);
+		for (nbUint32 i = 0u; i < nbTriangles; ++i)
+			primIds[i] = (nbUint32)keys[i];
+
+		// Binary SAH tree
+		std::vector<BuildNode> buildNodes(nbTriangles * 2u - 1u);
+		buildNodes[0].begin = 0u;
+		buildNodes[0].count = nbTriangles;
+
+		BinaryBuilder binaryBuilder(settings, primBounds, centroids, primIds, buildNodes);
+		binaryBuilder.build(0u, 0u);
+		buildNodes.resize(binaryBuilder.getNbNodes());
+
+		// Wide tree
+		m_nodes.reserve(buildNodes.size() / (BvhNode::Width - 1u) + 1u);
+		m_packets.reserve(getNbPackets(nbTriangles) * 2u);
+
+		WideBuilder wideBuilder(settings, buildNodes, primIds, vertices, indices, m_nodes, m_packets, m_stats);
+		wideBuilder.build(0u, 1u);
+		NEBULA_ASSERT(m_stats.maxDepth <= BvhMaxDepth);
+
+		m_bounds = buildNodes[0].bounds;
+		m_stats.nbTriangles = nbTriangles;
+		m_stats.nbNodes = (nbUint32)m_nodes.size();
+
+		if (settings.m_nodeLayout == BvhNodeLayout::Compressed)
+			compressNodes();
+
+		updateNodeBytes();
+
+		const std::chrono::duration<nbFloat64> elapsed = std::chrono::high_resolution_clock::now() - start;
+		m_stats.buildSeconds = elapsed.count();
+	}
+
+	void Bvh::compressNodes()
+	{
+		m_compressedNodes.resize(m_nodes.size());
+
+		tbb::parallel_for(size_t(0), m_nodes.size(), [&](size_t i)
+		{
+			m_compressedNodes[i] = compressNode(m_nodes[i]);
+		});
+
+		m_nodes.clear();
+		m_nodes.shrink_to_fit();
+	}
+
+	void Bvh::updateNodeBytes()
+	{
+		m_stats.nodeBytes = m_nodes.size() * sizeof(BvhNode) + m_compressedNodes.size() * sizeof(BvhCompressedNode);
+	}
+
+	nbBool Bvh::intersect(const glm::vec3& origin, const glm::vec3& direction, nbFloat32 tMax, BvhHit& dst,
+		BvhTraversalStats* traversalStats) const
+	{
+		if (!m_compressedNodes.empty())
+			return traverse(m_compressedNodes, origin, direction, tMax, dst, traversalStats);
+
+		if (!m_nodes.empty())
+			return traverse(m_nodes, origin, direction, tMax, dst, traversalStats);
+
+		return false;
+	}
+
+	template <typename NodeArrayT>
+	nbBool Bvh::traverse(const NodeArrayT& nodes, const glm::vec3& origin, const glm::vec3& direction, nbFloat32 tMax, BvhHit& dst,
+		BvhTraversalStats* traversalStats) const
+	{
+		const glm::vec3 invDirection = getSafeInverse(direction);
+
+		BvhStackEntry stack[BvhStackSize];
+		nbUint32 stackSize = 0u;
+		stack[stackSize++] = { 0u, 0.0f };
+
+		nbFloat32 closest = tMax;
+		nbBool found = false;
+
+		while (stackSize)
+		{
+			const BvhStackEntry entry = stack[--stackSize];
+			if (entry.tNear >= closest)
+				continue;
+
+			if (entry.child & BvhNode::LeafFlag)
+			{
+				const BvhTrianglePacket& packet = m_packets[entry.child & ~BvhNode::LeafFlag];
+
+				if (traversalStats)
+					++traversalStats->nbPacketTests;
+
+				nbFloat32 ts[BvhNode::Width];
+				nbFloat32 us[BvhNode::Width];
+				nbFloat32 vs[BvhNode::Width];
+				intersectPacket(packet, origin, direction, false, ts, us, vs);
+
+				for (nbUint32 lane = 0u; lane < BvhNode::Width; ++lane)
+				{
+					if (ts[lane] > 0.0f && ts[lane] < closest)
+					{
+						closest = ts[lane];
+						dst.t = ts[lane];
+						dst.u = us[lane];
+						dst.v = vs[lane];
+						dst.primIdx = packet.primIdx[lane];
+						found = true;
+					}
+				}
+
+				continue;
+			}
+
+			if (traversalStats)
+				++traversalStats->nbNodeVisits;
+
+			pushHitChildren(nodes[entry.child], origin, invDirection, closest, stack, stackSize);
+		}
+
+		return found;
+	}
+
+	nbFloat32 Bvh::occlusion(const glm::vec3& origin, const glm::vec3& direction, nbFloat32 tMax, BvhTraversalStats* traversalStats) const
+	{
+		if (!m_compressedNodes.empty())
+			return traverseOcclusion(m_compressedNodes, origin, direction, tMax, traversalStats);
+
+		if (!m_nodes.empty())
+			return traverseOcclusion(m_nodes, origin, direction, tMax, traversalStats);
+
+		return 0.0f;
+	}
+
+	template <typename NodeArrayT>
+	nbFloat32 Bvh::traverseOcclusion(const NodeArrayT& nodes, const glm::vec3& origin, const glm::vec3& direction, nbFloat32 tMax,
+		BvhTraversalStats* traversalStats) const
+	{
+		const glm::vec3 invDirection = getSafeInverse(direction);
+
+		const nbBool lowSideFirst = isLowSideFirst(direction);
+		const nbBool translucent = hasOpacities();
+
+		BvhStackEntry stack[BvhStackSize];
+		nbUint32 stackSize = 0u;
+		stack[stackSize++] = { 0u, 0.0f };
+
+		nbFloat32 transmittance = 1.0f;
+
+		while (stackSize)
+		{
+			const BvhStackEntry entry = stack[--stackSize];
+
+			if (entry.child & BvhNode::LeafFlag)
+			{
+				const BvhTrianglePacket& packet = m_packets[entry.child & ~BvhNode::LeafFlag];
+
+				if (traversalStats)
+					++traversalStats->nbPacketTests;
+
+				nbFloat32 ts[BvhNode::Width];
+				nbFloat32 us[BvhNode::Width];
+				nbFloat32 vs[BvhNode::Width];
+				intersectPacket(packet, origin, direction, true, ts, us, vs);
+
+				for (nbUint32 lane = 0u; lane < BvhNode::Width; ++lane)
+				{
+					if (ts[lane] <= 0.0f || ts[lane] >= tMax)
+						continue;
+
+					if (!translucent)
+						return 1.0f;
+
+					transmittance *= 1.0f - m_opacities[packet.primIdx[lane]];
+					if (transmittance <= 0.0f)
+						return 1.0f;
+				}
+
+				continue;
+			}
+
+			if (traversalStats)
+				++traversalStats->nbNodeVisits;
+
+			pushHitChildrenBySign(nodes[entry.child], origin, invDirection, tMax, lowSideFirst, stack, stackSize);
+		}
+
+		return 1.0f - transmittance;
+	}
+
+	void Bvh::setOpacities(std::vector<nbFloat32> opacities)
+	{
+		// Read per hit primIdx without checks.
+		NEBULA_ASSERT(opacities.empty() || opacities.size() == m_stats.nbTriangles);
+		NEBULA_ASSERT(!std::any_of(opacities.begin(), opacities.end(), [](nbFloat32 o) { return o < 0.0f || o > 1.0f; }));
+		m_opacities = std::move(opacities);
+	}
+
+	void Bvh::intersect(const BvhRayStream& rays, BvhHitStream& dst, BvhTraversalStats* traversalStats) const
+	{
+		BvhRayPacket packet;
+		nbUint32 first = 0u;
+
+		while (gatherRayPacket(rays, first, packet))
+		{
+			BvhHit hits[BvhNode::Width];
+			nbBool found[BvhNode::Width] = {};
+
+			if (!m_compressedNodes.empty())
+				traversePacket(m_compressedNodes, packet, rays.packetWalk, hits, found, traversalStats);
+			else if (!m_nodes.empty())
+				traversePacket(m_nodes, packet, rays.packetWalk, hits, found, traversalStats);
+
+			for (nbUint32 i = 0u; i < packet.size; ++i)
+			{
+				const nbUint32 rayIdx = packet.rayIds[i];
+				dst.hit[rayIdx] = found[i] ? 1u : 0u;
+
+				if (found[i])
+				{
+					dst.t[rayIdx] = hits[i].t;
+					dst.u[rayIdx] = hits[i].u;
+					dst.v[rayIdx] = hits[i].v;
+					dst.primIdx[rayIdx] = hits[i].primIdx;
+				}
+			}
+		}
+	}
+
+	void Bvh::occlusion(const BvhRayStream& rays, nbFloat32* dst, BvhTraversalStats* traversalStats) const
+	{
+		BvhRayPacket packet;
+		nbUint32 first = 0u;
+
+		while (gatherRayPacket(rays, first, packet))
+		{
+			nbFloat32 occlusions[BvhNode::Width] = {};
+
+			if (!m_compressedNodes.empty())
+				traversePacketOcclusion(m_compressedNodes, packet, rays.packetWalk, occlusions, traversalStats);
+			else if (!m_nodes.empty())
+				traversePacketOcclusion(m_nodes, packet, rays.packetWalk, occlusions, traversalStats);
+
+			for (nbUint32 i = 0u; i < packet.size; ++i)
+				dst[packet.rayIds[i]] = occlusions[i];
+		}
+	}
+
+	template <typename NodeArrayT>
+	void Bvh::traversePacket(const NodeArrayT& nodes, const BvhRayPacket& packet, nbBool packetWalk, BvhHit (&hits)[BvhNode::Width],
+		nbBool (&found)[BvhNode::Width], BvhTraversalStats* traversalStats) const
+	{
+		if (!packetWalk || !isCoherent(packet))
+		{
+			for (nbUint32 i = 0u; i < packet.size; ++i)
+				found[i] = traverse(nodes, packet.origins[i], packet.directions[i], packet.tMaxs[i], hits[i], traversalStats);
+
+			return;
+		}
+
+		BvhPacketStackEntry stack[BvhStackSize];
+		nbUint32 stackSize = 0u;
+		stack[stackSize++] = { 0u, 0.0f, (1u << packet.size) - 1u };
+
+		nbFloat32 closests[BvhNode::Width];
+		for (nbUint32 i = 0u; i < packet.size; ++i)
+			closests[i] = packet.tMaxs[i];
+
+		while (stackSize)
+		{
+			const BvhPacketStackEntry entry = stack[--stackSize];
+
+			// Rays with a closer hit than the nearest entry of the child are left out.
+			nbUint32 rayMask = 0u;
+			for (nbUint32 i = 0u; i < packet.size; ++i)
+			{
+				if ((entry.rayMask & (1u << i)) && entry.tNear < closests[i])
+					rayMask |= 1u << i;
+			}
+
+			if (!rayMask)
+				continue;
+
+			if (entry.child & BvhNode::LeafFlag)
+			{
+				const BvhTrianglePacket& trianglePacket = m_packets[entry.child & ~BvhNode::LeafFlag];
+
+				if (traversalStats)
+					++traversalStats->nbPacketTests;
+
+				for (nbUint32 i = 0u; i < packet.size; ++i)
+				{
+					if (!(rayMask & (1u << i)))
+						continue;
+
+					nbFloat32 ts[BvhNode::Width];
+					nbFloat32 us[BvhNode::Width];
+					nbFloat32 vs[BvhNode::Width];
+					intersectPacket(trianglePacket, packet.origins[i], packet.directions[i], false, ts, us, vs);
+
+					for (nbUint32 lane = 0u; lane < BvhNode::Width; ++lane)
+					{
+						if (ts[lane] > 0.0f && ts[lane] < closests[i])
+						{
+							closests[i] = ts[lane];
+							hits[i].t = ts[lane];
+							hits[i].u = us[lane];
+							hits[i].v = vs[lane];
+							hits[i].primIdx = trianglePacket.primIdx[lane];
+							found[i] = true;
+						}
+					}
+				}
+
+				continue;
+			}
+
+			if (traversalStats)
+				++traversalStats->nbNodeVisits;
+
+			pushPacketHitChildren(nodes[entry.child], packet, rayMask, closests, true, true, stack, stackSize);
+		}
+	}
+
+	template <typename NodeArrayT>
+	void Bvh::traversePacketOcclusion(const NodeArrayT& nodes, const BvhRayPacket& packet, nbBool packetWalk, nbFloat32 (&occlusions)[BvhNode::Width],
+		BvhTraversalStats* traversalStats) const
+	{
+		if (!packetWalk || !isCoherent(packet))
+		{
+			for (nbUint32 i = 0u; i < packet.size; ++i)
+				occlusions[i] = traverseOcclusion(nodes, packet.origins[i], packet.directions[i], packet.tMaxs[i], traversalStats);
+
+			return;
+		}
+
+		// Rays of a coherent packet share the visit order of the first one.
+		const nbBool lowSideFirst = isLowSideFirst(packet.directions[0]);
+		const nbBool translucent = hasOpacities();
+
+		BvhPacketStackEntry stack[BvhStackSize];
+		nbUint32 stackSize = 0u;
+		stack[stackSize++] = { 0u, 0.0f, (1u << packet.size) - 1u };
+
+		nbFloat32 transmittances[BvhNode::Width];
+		for (nbUint32 i = 0u; i < packet.size; ++i)
+			transmittances[i] = 1.0f;
+
+		// Rays still looking for occluders.
+		nbUint32 openMask = (1u << packet.size) - 1u;
+
+		while (stackSize && openMask)
+		{
+			const BvhPacketStackEntry entry = stack[--stackSize];
+
+			const nbUint32 rayMask = entry.rayMask & openMask;
+			if (!rayMask)
+				continue;
+
+			if (entry.child & BvhNode::LeafFlag)
+			{
+				const BvhTrianglePacket& trianglePacket = m_packets[entry.child & ~BvhNode::LeafFlag];
+
+				if (traversalStats)
+					++traversalStats->nbPacketTests;
+
+				for (nbUint32 i = 0u; i < packet.size; ++i)
+				{
+					if (!(rayMask & (1u << i)))
+						continue;
+
+					nbFloat32 ts[BvhNode::Width];
+					nbFloat32 us[BvhNode::Width];
+					nbFloat32 vs[BvhNode::Width];
+					intersectPacket(trianglePacket, packet.origins[i], packet.directions[i], true, ts, us, vs);
+
+					for (nbUint32 lane = 0u; lane < BvhNode::Width; ++lane)
+					{
+						if (ts[lane] <= 0.0f || ts[lane] >= packet.tMaxs[i])
+							continue;
+
+						transmittances[i] = !translucent ? 0.0f : transmittances[i] * (1.0f - m_opacities[trianglePacket.primIdx[lane]]);
+						if (transmittances[i] <= 0.0f)
+						{
+							transmittances[i] = 0.0f;
+							openMask &= ~(1u << i);
+							break;
+						}
+					}
+				}
+
+				continue;
+			}
+
+			if (traversalStats)
+				++traversalStats->nbNodeVisits;
+
+			pushPacketHitChildren(nodes[entry.child], packet, rayMask, packet.tMaxs, false, lowSideFirst, stack, stackSize);
+		}
+
+		for (nbUint32 i = 0u; i < packet.size; ++i)
+			occlusions[i] = 1.0f - transmittances[i];
+	}
+
+	void Bvh::store(Cache::SceneCacheWriter& writer, nbUint32 meshIdx) const
+	{
+		if (m_compressedNodes.empty())
+			writer.addSection(Cache::SceneCacheSection::BvhNodes, meshIdx, m_nodes);
+		else
+			writer.addSection(Cache::SceneCacheSection::BvhCompressedNodes, meshIdx, m_compressedNodes);
+
+		writer.addSection(Cache::SceneCacheSection::BvhPackets, meshIdx, m_packets);
+	}
+
+	nbBool Bvh::load(const Cache::SceneCache& cache, nbUint32 meshIdx)
+	{
+		const auto nodes = cache.getSection<BvhNode>(Cache::SceneCacheSection::BvhNodes, meshIdx);
+		const auto compressedNodes = cache.getSection<BvhCompressedNode>(Cache::SceneCacheSection::BvhCompressedNodes, meshIdx);
+		const auto packets = cache.getSection<BvhTrianglePacket>(Cache::SceneCacheSection::BvhPackets, meshIdx);
+
+		if ((nodes.empty() && compressedNodes.empty()) || packets.empty())
+			return false;
+
+		if (!checkChildren(nodes, packets) || !checkChildren(compressedNodes, packets))
+		{
+			NEBULA_TRACE("Bvh::load - Invalid child index");
+			return false;
+		}
+
+		if (!checkDepth(nodes) || !checkDepth(compressedNodes))
+		{
+			NEBULA_TRACE("Bvh::load - Tree too deep");
+			return false;
+		}
+
+		m_nodes.assign(nodes.begin(), nodes.end());
+		m_compressedNodes.assign(compressedNodes.begin(), compressedNodes.end());
+		m_packets.assign(packets.begin(), packets.end());
+		m_opacities.clear();
+
+		m_stats = BvhStats();
+		for (const BvhTrianglePacket& packet : m_packets)
+		{
+			for (nbUint32 lane = 0u; lane < BvhNode::Width; ++lane)
+			{
+				if (packet.primIdx[lane] != BvhNode::EmptyChild)
+					m_stats.nbTriangles = std::max(m_stats.nbTriangles, packet.primIdx[lane] + 1u);
+			}
+		}
+
+		m_stats.nbNodes = (nbUint32)(m_nodes.size() + m_compressedNodes.size());
+		m_stats.nbLeaves = (nbUint32)m_packets.size();
+
+		updateNodeBytes();
+		computeBounds();
+		return true;
+	}
+
+	void Bvh::computeBounds()
+	{
+		m_bounds = Aabb();
+
+		auto extendRoot = [&](const auto& root)
+		{
+			for (nbUint32 lane = 0u; lane < BvhNode::Width; ++lane)
+			{
+				if (root.children[lane] != BvhNode::EmptyChild)
+					m_bounds.extend(getLaneBounds(root, lane));
+			}
+		};
+
+		if (!m_compressedNodes.empty())
+			extendRoot(m_compressedNodes[0]);
+		else
+			extendRoot(m_nodes[0]);
+	}
+
+}}}}
\ No newline at end of file
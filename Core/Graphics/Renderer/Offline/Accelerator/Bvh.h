@@ -0,0 +1,293 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include "Aabb.h"
+#include "../../Cache/SceneCache.h"
+#include "tbb/cache_aligned_allocator.h"
+#include <vector>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Accelerator
+{
+enum class BvhNodeLayout
+{
+	// Float children bounds.
+	Full,
+
+	// Children bounds quantized on 8 bits. Less than half the bytes of Full, for scenes where traversal is bandwidth bound.
+	Compressed
+};
+
+struct BvhSettings
+{
+	BvhNodeLayout m_nodeLayout = BvhNodeLayout::Full;
+
+	// Split candidates per axis.
+	nbUint32 m_nbBins = 16u;
+
+	// Nodes with more triangles are split by parallel tasks.
+	nbUint32 m_parallelThreshold = 4096u;
+
+	// SAH costs of a node visit and of a triangle packet test.
+	nbFloat32 m_nodeCost = 1.0f;
+	nbFloat32 m_packetCost = 1.0f;
+};
+
+struct BvhStats
+{
+	nbUint32 nbTriangles = 0u;
+	nbUint32 nbNodes = 0u;
+	nbUint32 nbLeaves = 0u;
+	nbUint32 maxDepth = 0u;
+	nbUint64 nodeBytes = 0u;
+
+	// Expected cost of a random ray hitting the root, in node visits and packet tests weighted by the settings costs.
+	nbFloat32 sahCost = 0.0f;
+
+	nbFloat64 buildSeconds = 0.0;
+};
+
+// Wide node storing the bounds of its children, one lane per child.
+// The width matches the triangle packets width so both are tested with the same SIMD lanes.
+struct alignas(32) BvhNode
+{
+	static constexpr nbUint32 Width = NEBULA_INTRINSICS_NB_FLOAT;
+
+	// Child encoding: a node index, a packet index with LeafFlag set, or EmptyChild.
+	static constexpr nbUint32 LeafFlag = 0x80000000u;
+	static constexpr nbUint32 EmptyChild = 0xffffffffu;
+
+	nbFloat32 minX[Width];
+	nbFloat32 minY[Width];
+	nbFloat32 minZ[Width];
+	nbFloat32 maxX[Width];
+	nbFloat32 maxY[Width];
+	nbFloat32 maxZ[Width];
+
+	nbUint32 children[Width];
+};
+
+// BvhNode with the children bounds quantized relative to a frame covering all the children.
+// A bound is origin + q * 2^(exponent - 127), with minimums rounded down and maximums rounded up so boxes stay conservative.
+// @See: Ylitie et al., Efficient Incoherent Ray Traversal on GPUs Through Compressed Wide BVHs
+struct alignas(32) BvhCompressedNode
+{
+	nbFloat32 origin[3];
+
+	// Biased exponents of the per axis scales, as in the float format.
+	nbUint8 exponents[3];
+	nbUint8 padding;
+
+	nbUint8 qMinX[BvhNode::Width];
+	nbUint8 qMinY[BvhNode::Width];
+	nbUint8 qMinZ[BvhNode::Width];
+	nbUint8 qMaxX[BvhNode::Width];
+	nbUint8 qMaxY[BvhNode::Width];
+	nbUint8 qMaxZ[BvhNode::Width];
+
+	nbUint32 children[BvhNode::Width];
+};
+
+// Triangles of a leaf, stored as a vertex and two edges. Unused lanes are degenerate and never hit.
+struct alignas(32) BvhTrianglePacket
+{
+	nbFloat32 v0x[BvhNode::Width];
+	nbFloat32 v0y[BvhNode::Width];
+	nbFloat32 v0z[BvhNode::Width];
+	nbFloat32 e1x[BvhNode::Width];
+	nbFloat32 e1y[BvhNode::Width];
+	nbFloat32 e1z[BvhNode::Width];
+	nbFloat32 e2x[BvhNode::Width];
+	nbFloat32 e2y[BvhNode::Width];
+	nbFloat32 e2z[BvhNode::Width];
+
+	// Index of the triangle in the source mesh. EmptyChild for unused lanes.
+	nbUint32 primIdx[BvhNode::Width];
+};
+
+struct BvhHit
+{
+	nbFloat32 t;
+
+	// Barycentric coordinates of the hit relative to the second and third vertices.
+	nbFloat32 u;
+	nbFloat32 v;
+
+	nbUint32 primIdx;
+};
+
+// Rays of a stream query, as arrays of size elements. The arrays are owned by the caller.
+struct BvhRayStream
+{
+	const nbFloat32* originX = nullptr;
+	const nbFloat32* originY = nullptr;
+	const nbFloat32* originZ = nullptr;
+	const nbFloat32* directionX = nullptr;
+	const nbFloat32* directionY = nullptr;
+	const nbFloat32* directionZ = nullptr;
+
+	// Rays are tested in ]0, tMax[.
+	const nbFloat32* tMax = nullptr;
+
+	// Non zero for the rays to trace. The results of the other rays are left untouched. Null when all rays are active.
+	const nbUint8* active = nullptr;
+
+	nbUint32 size = 0u;
+
+	// Opt in to the packet walk of coherent groups. It is still slower than ray by ray walks, keep it off outside of profiling.
+	nbBool packetWalk = false;
+};
+
+// Closest hits of a stream query, as arrays of the stream size.
+struct BvhHitStream
+{
+	// Non zero when the other fields of the ray are valid.
+	nbUint8* hit = nullptr;
+
+	nbFloat32* t = nullptr;
+	nbFloat32* u = nullptr;
+	nbFloat32* v = nullptr;
+	nbUint32* primIdx = nullptr;
+};
+
+// Work of a traversal, for profiling.
+struct BvhTraversalStats
+{
+	nbUint64 nbNodeVisits = 0u;
+	nbUint64 nbPacketTests = 0u;
+};
+
+struct BvhRayPacket;
+
+// Wide bounding volume hierarchy over the triangles of a mesh.
+// Triangles are first sorted by the morton code of their centroid. A binary tree is then built top down with binned SAH
+// splits, large nodes being split by parallel tasks, and is finally collapsed into BvhNode::Width wide nodes.
+// Partitions are stable so the triangles of a leaf, and neighbouring leaves, stay close along the morton curve.
+// @See: Wald, On fast Construction of SAH-based Bounding Volume Hierarchies
+class Bvh
+{
+public:
+	using NodeArray = std::vector<BvhNode, tbb::cache_aligned_allocator<BvhNode>>;
+	using CompressedNodeArray = std::vector<BvhCompressedNode, tbb::cache_aligned_allocator<BvhCompressedNode>>;
+	using PacketArray = std::vector<BvhTrianglePacket, tbb::cache_aligned_allocator<BvhTrianglePacket>>;
+
+	// Each triangle is three consecutive entries of indices.
+	void build(const std::vector<glm::vec3>& vertices, const std::vector<nbUint32>& indices, const BvhSettings& settings = BvhSettings());
+
+	// Closest hit in ]0, tMax[. The traversal work is added to traversalStats when set.
+	nbBool intersect(const glm::vec3& origin, const glm::vec3& direction, nbFloat32 tMax, BvhHit& dst,
+		BvhTraversalStats* traversalStats = nullptr) const;
+
+	// Fraction of the light blocked along ]0, tMax[, in [0, 1]. Shadow rays only need this, so the traversal
+	// keeps no closest hit, does not sort the children and stops at the first opaque hit.
+	// Translucent triangles attenuate the light by their transmittance, in any order.
+	nbFloat32 occlusion(const glm::vec3& origin, const glm::vec3& direction, nbFloat32 tMax,
+		BvhTraversalStats* traversalStats = nullptr) const;
+
+	// Stream versions of intersect and occlusion, writing the result of each active ray at its stream index.
+	// Rays are traced one by one, unless the stream opts in to the packet walk: active rays are then grouped by BvhNode::Width
+	// consecutive ones, and a group going toward a single octant walks the tree as a packet, each node being fetched once
+	// for the rays overlapping it. Streams sorted by origin and direction, or sharing an origin, get the most from it.
+	// A packet node visit or packet test counts once in traversalStats.
+	void intersect(const BvhRayStream& rays, BvhHitStream& dst, BvhTraversalStats* traversalStats = nullptr) const;
+	void occlusion(const BvhRayStream& rays, nbFloat32* dst, BvhTraversalStats* traversalStats = nullptr) const;
+
+	// Opacity in [0, 1] of each triangle of the built or loaded mesh, from its material. Empty when all triangles are opaque, the default.
+	// Opacities are not stored in the scene cache, they follow the materials. Building or loading clears them.
+	void setOpacities(std::vector<nbFloat32> opacities);
+
+	// The arrays are read when the writer writes, the bvh must stay alive until then.
+	void store(Cache::SceneCacheWriter& writer, nbUint32 meshIdx) const;
+
+	// False if the cache has no valid bvh for this mesh.
+	nbBool load(const Cache::SceneCache& cache, nbUint32 meshIdx);
+
+	nbBool empty() const;
+	BvhNodeLayout getNodeLayout() const;
+	const Aabb& getBounds() const;
+	const BvhStats& getStats() const;
+
+	// Only the array of the node layout is filled.
+	const NodeArray& getNodes() const;
+	const CompressedNodeArray& getCompressedNodes() const;
+	const PacketArray& getPackets() const;
+
+private:
+	template <typename NodeArrayT>
+	nbBool traverse(const NodeArrayT& nodes, const glm::vec3& origin, const glm::vec3& direction, nbFloat32 tMax, BvhHit& dst,
+		BvhTraversalStats* traversalStats) const;
+
+	template <typename NodeArrayT>
+	nbFloat32 traverseOcclusion(const NodeArrayT& nodes, const glm::vec3& origin, const glm::vec3& direction, nbFloat32 tMax,
+		BvhTraversalStats* traversalStats) const;
+
+	// Packets not coherent, or not walked as packets, are traced ray by ray.
+	template <typename NodeArrayT>
+	void traversePacket(const NodeArrayT& nodes, const BvhRayPacket& packet, nbBool packetWalk, BvhHit (&hits)[BvhNode::Width],
+		nbBool (&found)[BvhNode::Width], BvhTraversalStats* traversalStats) const;
+
+	template <typename NodeArrayT>
+	void traversePacketOcclusion(const NodeArrayT& nodes, const BvhRayPacket& packet, nbBool packetWalk, nbFloat32 (&occlusions)[BvhNode::Width],
+		BvhTraversalStats* traversalStats) const;
+
+	// False as well when the opacities do not match the triangles, e.g. set for another mesh, so they are never read out of bounds.
+	nbBool hasOpacities() const;
+
+	void compressNodes();
+	void computeBounds();
+	void updateNodeBytes();
+
+	NodeArray m_nodes;
+	CompressedNodeArray m_compressedNodes;
+	PacketArray m_packets;
+	std::vector<nbFloat32> m_opacities;
+
+	Aabb m_bounds;
+	BvhStats m_stats;
+};
+
+inline nbBool Bvh::empty() const
+{
+	return m_nodes.empty() && m_compressedNodes.empty();
+}
+
+inline nbBool Bvh::hasOpacities() const
+{
+	return !m_opacities.empty() && m_opacities.size() == m_stats.nbTriangles;
+}
+
+inline BvhNodeLayout Bvh::getNodeLayout() const
+{
+	return m_compressedNodes.empty() ? BvhNodeLayout::Full : BvhNodeLayout::Compressed;
+}
+
+inline const Aabb& Bvh::getBounds() const
+{
+	return m_bounds;
+}
+
+inline const BvhStats& Bvh::getStats() const
+{
+	return m_stats;
+}
+
+inline const Bvh::NodeArray& Bvh::getNodes() const
+{
+	return m_nodes;
+}
+
+inline const Bvh::CompressedNodeArray& Bvh::getCompressedNodes() const
+{
+	return m_compressedNodes;
+}
+
+inline const Bvh::PacketArray& Bvh::getPackets() const
+{
+	return m_packets;
+}
+}}}}
\ No newline at end of file
@@ -0,0 +1,313 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include "Bvh.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Accelerator
+{
+struct BvhStackEntry
+{
+	nbUint32 child;
+	nbFloat32 tNear;
+};
+
+// Deepest wide tree the traversals accept, the builder caps the depth of its trees to it.
+constexpr nbUint32 BvhMaxDepth = 64u;
+
+// A visited node pushes at most BvhNode::Width entries for the one it pops, so each level leaves at most
+// BvhNode::Width - 1 entries behind and a tree of BvhMaxDepth levels fits.
+constexpr nbUint32 BvhStackSize = BvhMaxDepth * BvhNode::Width;
+
+// Avoids 0 * infinity in the slab tests when the ray origin lies on a box plane.
+inline glm::vec3 getSafeInverse(const glm::vec3& direction)
+{
+	glm::vec3 inv;
+	for (nbUint32 i = 0u; i < 3u; ++i)
+	{
+		const nbFloat32 d = std::abs(direction[i]) > 1e-20f ? direction[i] : std::copysign(1e-20f, direction[i]);
+		inv[i] = 1.0f / d;
+	}
+
+	return inv;
+}
+
+// Scale of a compressed node axis.
+inline nbFloat32 getCompressedScale(nbUint8 exponent)
+{
+	const nbUint32 bits = (nbUint32)exponent << 23u;
+
+	nbFloat32 scale;
+	std::memcpy(&scale, &bits, sizeof(scale));
+	return scale;
+}
+
+// Entry and exit distances of the ray in each lane of node, clamped to [0, tMax].
+// The lanes the ray misses have tNears above tFars.
+inline void computeLaneDistances(const BvhNode& node, const glm::vec3& origin, const glm::vec3& invDirection, nbFloat32 tMax,
+	nbFloat32 (&tNears)[BvhNode::Width], nbFloat32 (&tFars)[BvhNode::Width])
+{
+	for (nbUint32 lane = 0u; lane < BvhNode::Width; ++lane)
+	{
+		const nbFloat32 t0x = (node.minX[lane] - origin.x) * invDirection.x;
+		const nbFloat32 t1x = (node.maxX[lane] - origin.x) * invDirection.x;
+		const nbFloat32 t0y = (node.minY[lane] - origin.y) * invDirection.y;
+		const nbFloat32 t1y = (node.maxY[lane] - origin.y) * invDirection.y;
+		const nbFloat32 t0z = (node.minZ[lane] - origin.z) * invDirection.z;
+		const nbFloat32 t1z = (node.maxZ[lane] - origin.z) * invDirection.z;
+
+		tNears[lane] = std::max(std::max(std::min(t0x, t1x), std::min(t0y, t1y)), std::max(std::min(t0z, t1z), 0.0f));
+		tFars[lane] = std::min(std::min(std::max(t0x, t1x), std::max(t0y, t1y)), std::min(std::max(t0z, t1z), tMax));
+	}
+}
+
+// Same on a compressed node. The encoder rounds the bounds one step outward, so boxes stay conservative
+// even if this decoding rounds differently from its own.
+inline void computeLaneDistances(const BvhCompressedNode& node, const glm::vec3& origin, const glm::vec3& invDirection, nbFloat32 tMax,
+	nbFloat32 (&tNears)[BvhNode::Width], nbFloat32 (&tFars)[BvhNode::Width])
+{
+	const glm::vec3 scale(getCompressedScale(node.exponents[0]), getCompressedScale(node.exponents[1]), getCompressedScale(node.exponents[2]));
+
+	for (nbUint32 lane = 0u; lane < BvhNode::Width; ++lane)
+	{
+		const nbFloat32 t0x = (node.origin[0] + node.qMinX[lane] * scale.x - origin.x) * invDirection.x;
+		const nbFloat32 t1x = (node.origin[0] + node.qMaxX[lane] * scale.x - origin.x) * invDirection.x;
+		const nbFloat32 t0y = (node.origin[1] + node.qMinY[lane] * scale.y - origin.y) * invDirection.y;
+		const nbFloat32 t1y = (node.origin[1] + node.qMaxY[lane] * scale.y - origin.y) * invDirection.y;
+		const nbFloat32 t0z = (node.origin[2] + node.qMinZ[lane] * scale.z - origin.z) * invDirection.z;
+		const nbFloat32 t1z = (node.origin[2] + node.qMaxZ[lane] * scale.z - origin.z) * invDirection.z;
+
+		tNears[lane] = std::max(std::max(std::min(t0x, t1x), std::min(t0y, t1y)), std::max(std::min(t0z, t1z), 0.0f));
+		tFars[lane] = std::min(std::min(std::max(t0x, t1x), std::max(t0y, t1y)), std::min(std::max(t0z, t1z), tMax));
+	}
+}
+
+// Pushes the children of node overlapping [0, tMax] along the ray. Farthest first, so the nearest is visited next.
+template <typename NodeT>
+inline void pushHitChildren(const NodeT& node, const glm::vec3& origin, const glm::vec3& invDirection, nbFloat32 tMax,
+	BvhStackEntry* stack, nbUint32& stackSize)
+{
+	nbFloat32 tNears[BvhNode::Width];
+	nbFloat32 tFars[BvhNode::Width];
+	computeLaneDistances(node, origin, invDirection, tMax, tNears, tFars);
+
+	NEBULA_ASSERT(stackSize + BvhNode::Width <= BvhStackSize);
+	BvhStackEntry* hits = stack + stackSize;
+	nbUint32 nbHits = 0u;
+
+	for (nbUint32 lane = 0u; lane < BvhNode::Width; ++lane)
+	{
+		if (node.children[lane] == BvhNode::EmptyChild || tNears[lane] > tFars[lane])
+			continue;
+
+		nbUint32 i = nbHits++;
+		for (; i > 0u && hits[i - 1u].tNear < tNears[lane]; --i)
+			hits[i] = hits[i - 1u];
+
+		hits[i] = { node.children[lane], tNears[lane] };
+	}
+
+	stackSize += nbHits;
+}
+
+// Any hit visit order: the low side of the splits first when the ray goes toward positive coordinates on its dominant axis.
+inline nbBool isLowSideFirst(const glm::vec3& direction)
+{
+	const glm::vec3 absDirection(std::abs(direction.x), std::abs(direction.y), std::abs(direction.z));
+	const nbUint32 dominantAxis = absDirection.x >= absDirection.y && absDirection.x >= absDirection.z ? 0u : (absDirection.y >= absDirection.z ? 1u : 2u);
+	return direction[dominantAxis] >= 0.0f;
+}
+
+// Any hit version, without sorting. Lanes are stored with the low side of the split axes first,
+// so the lane order, reversed for rays going toward negative coordinates, approximates a near to far order.
+template <typename NodeT>
+inline void pushHitChildrenBySign(const NodeT& node, const glm::vec3& origin, const glm::vec3& invDirection, nbFloat32 tMax,
+	nbBool lowSideFirst, BvhStackEntry* stack, nbUint32& stackSize)
+{
+	nbFloat32 tNears[BvhNode::Width];
+	nbFloat32 tFars[BvhNode::Width];
+	computeLaneDistances(node, origin, invDirection, tMax, tNears, tFars);
+
+	NEBULA_ASSERT(stackSize + BvhNode::Width <= BvhStackSize);
+
+	// The last pushed is visited first.
+	for (nbUint32 i = 0u; i < BvhNode::Width; ++i)
+	{
+		const nbUint32 lane = lowSideFirst ? BvhNode::Width - 1u - i : i;
+		if (node.children[lane] == BvhNode::EmptyChild || tNears[lane] > tFars[lane])
+			continue;
+
+		stack[stackSize++] = { node.children[lane], tNears[lane] };
+	}
+}
+
+// Edge of a triangle going along it toward positive coordinates, x first, then y and z. Triangles wound alike go along
+// their shared edges in opposite directions, so exactly one of them owns each.
+inline nbBool isOwnedEdge(nbFloat32 x, nbFloat32 y, nbFloat32 z)
+{
+	return x != 0.0f ? x > 0.0f : (y != 0.0f ? y > 0.0f : z > 0.0f);
+}
+
+// Moller-Trumbore on every lane of packet. ts[lane] is negative when the lane is missed.
+// Edges are inclusive, unless ownedEdgesOnly where a hit exactly on an edge counts only for the triangle owning it,
+// so an any hit walk crossing two translucent triangles through their shared edge attenuates once.
+inline void intersectPacket(const BvhTrianglePacket& packet, const glm::vec3& origin, const glm::vec3& direction, nbBool ownedEdgesOnly,
+	nbFloat32 (&ts)[BvhNode::Width], nbFloat32 (&us)[BvhNode::Width], nbFloat32 (&vs)[BvhNode::Width])
+{
+	for (nbUint32 lane = 0u; lane < BvhNode::Width; ++lane)
+	{
+		const nbFloat32 px = direction.y * packet.e2z[lane] - direction.z * packet.e2y[lane];
+		const nbFloat32 py = direction.z * packet.e2x[lane] - direction.x * packet.e2z[lane];
+		const nbFloat32 pz = direction.x * packet.e2y[lane] - direction.y * packet.e2x[lane];
+
+		const nbFloat32 det = packet.e1x[lane] * px + packet.e1y[lane] * py + packet.e1z[lane] * pz;
+		const nbFloat32 invDet = det != 0.0f ? 1.0f / det : 0.0f;
+
+		const nbFloat32 tx = origin.x - packet.v0x[lane];
+		const nbFloat32 ty = origin.y - packet.v0y[lane];
+		const nbFloat32 tz = origin.z - packet.v0z[lane];
+
+		const nbFloat32 qx = ty * packet.e1z[lane] - tz * packet.e1y[lane];
+		const nbFloat32 qy = tz * packet.e1x[lane] - tx * packet.e1z[lane];
+		const nbFloat32 qz = tx * packet.e1y[lane] - ty * packet.e1x[lane];
+
+		us[lane] = (tx * px + ty * py + tz * pz) * invDet;
+		vs[lane] = (direction.x * qx + direction.y * qy + direction.z * qz) * invDet;
+
+		nbBool inside = det != 0.0f && us[lane] >= 0.0f && vs[lane] >= 0.0f && us[lane] + vs[lane] <= 1.0f;
+		if (inside && ownedEdgesOnly)
+		{
+			// u = 0 on the edge from v2 to v0, v = 0 from v0 to v1, u + v = 1 from v1 to v2.
+			if (us[lane] == 0.0f)
+				inside = isOwnedEdge(-packet.e2x[lane], -packet.e2y[lane], -packet.e2z[lane]);
+			if (inside && vs[lane] == 0.0f)
+				inside = isOwnedEdge(packet.e1x[lane], packet.e1y[lane], packet.e1z[lane]);
+			if (inside && us[lane] + vs[lane] == 1.0f)
+				inside = isOwnedEdge(packet.e2x[lane] - packet.e1x[lane], packet.e2y[lane] - packet.e1y[lane], packet.e2z[lane] - packet.e1z[lane]);
+		}
+
+		ts[lane] = inside ? (packet.e2x[lane] * qx + packet.e2y[lane] * qy + packet.e2z[lane] * qz) * invDet : -1.0f;
+	}
+}
+
+// Up to BvhNode::Width rays of a stream, traced together.
+struct BvhRayPacket
+{
+	glm::vec3 origins[BvhNode::Width];
+	glm::vec3 directions[BvhNode::Width];
+	glm::vec3 invDirections[BvhNode::Width];
+	nbFloat32 tMaxs[BvhNode::Width];
+
+	// Index of each ray in the stream.
+	nbUint32 rayIds[BvhNode::Width];
+	nbUint32 size;
+};
+
+// Fills packet with the next active rays of the stream, starting at first which is moved past them.
+// Returns false when no active ray is left.
+inline nbBool gatherRayPacket(const BvhRayStream& rays, nbUint32& first, BvhRayPacket& packet)
+{
+	packet.size = 0u;
+
+	for (; first < rays.size && packet.size < BvhNode::Width; ++first)
+	{
+		if (rays.active && !rays.active[first])
+			continue;
+
+		const nbUint32 i = packet.size++;
+		packet.origins[i] = glm::vec3(rays.originX[first], rays.originY[first], rays.originZ[first]);
+		packet.directions[i] = glm::vec3(rays.directionX[first], rays.directionY[first], rays.directionZ[first]);
+		packet.invDirections[i] = getSafeInverse(packet.directions[i]);
+		packet.tMaxs[i] = rays.tMax[first];
+		packet.rayIds[i] = first;
+	}
+
+	return packet.size > 0u;
+}
+
+// True when all the rays of packet go toward the same octant. Other packets share few nodes and are better traced ray by ray.
+inline nbBool isCoherent(const BvhRayPacket& packet)
+{
+	for (nbUint32 i = 1u; i < packet.size; ++i)
+	{
+		for (nbUint32 axis = 0u; axis < 3u; ++axis)
+		{
+			if ((packet.directions[i][axis] < 0.0f) != (packet.directions[0][axis] < 0.0f))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+struct BvhPacketStackEntry
+{
+	nbUint32 child;
+	nbFloat32 tNear;
+
+	// Bit i is set when the ray i of the packet overlaps the child.
+	nbUint32 rayMask;
+};
+
+// Pushes the children of node overlapped by the rays of rayMask, each with the mask of the rays overlapping it.
+// Rays are tested up to their entry of tMaxs. Farthest nearest entry first, or by lane order when sorted is false.
+// @See: pushHitChildren, pushHitChildrenBySign.
+template <typename NodeT>
+inline void pushPacketHitChildren(const NodeT& node, const BvhRayPacket& packet, nbUint32 rayMask, const nbFloat32* tMaxs,
+	nbBool sorted, nbBool lowSideFirst, BvhPacketStackEntry* stack, nbUint32& stackSize)
+{
+	nbFloat32 tNears[BvhNode::Width];
+	nbUint32 laneMasks[BvhNode::Width];
+	for (nbUint32 lane = 0u; lane < BvhNode::Width; ++lane)
+	{
+		tNears[lane] = std::numeric_limits<nbFloat32>::infinity();
+		laneMasks[lane] = 0u;
+	}
+
+	for (nbUint32 i = 0u; i < packet.size; ++i)
+	{
+		if (!(rayMask & (1u << i)))
+			continue;
+
+		nbFloat32 rayNears[BvhNode::Width];
+		nbFloat32 rayFars[BvhNode::Width];
+		computeLaneDistances(node, packet.origins[i], packet.invDirections[i], tMaxs[i], rayNears, rayFars);
+
+		for (nbUint32 lane = 0u; lane < BvhNode::Width; ++lane)
+		{
+			if (rayNears[lane] > rayFars[lane])
+				continue;
+
+			tNears[lane] = std::min(tNears[lane], rayNears[lane]);
+			laneMasks[lane] |= 1u << i;
+		}
+	}
+
+	NEBULA_ASSERT(stackSize + BvhNode::Width <= BvhStackSize);
+	BvhPacketStackEntry* hits = stack + stackSize;
+	nbUint32 nbHits = 0u;
+
+	for (nbUint32 i = 0u; i < BvhNode::Width; ++i)
+	{
+		const nbUint32 lane = sorted || !lowSideFirst ? i : BvhNode::Width - 1u - i;
+		if (node.children[lane] == BvhNode::EmptyChild || !laneMasks[lane])
+			continue;
+
+		nbUint32 j = nbHits++;
+		for (; sorted && j > 0u && hits[j - 1u].tNear < tNears[lane]; --j)
+			hits[j] = hits[j - 1u];
+
+		hits[j] = { node.children[lane], tNears[lane], laneMasks[lane] };
+	}
+
+	stackSize += nbHits;
+}
+}}}}
\ No newline at end of file
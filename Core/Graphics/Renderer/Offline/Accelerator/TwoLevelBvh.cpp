@@ -0,0 +1,341 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#include "stdafx.h"
+#include "TwoLevelBvh.h"
+#include "BvhTraversal.h"
+#include <algorithm>
+#include <numeric>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Accelerator
+{
+	namespace
+	{
+		Aabb getNodeBounds(const BvhNode& node)
+		{
+			Aabb bounds;
+			for (nbUint32 lane = 0u; lane < BvhNode::Width; ++lane)
+			{
+				if (node.children[lane] == BvhNode::EmptyChild)
+					continue;
+
+				bounds.extend(glm::vec3(node.minX[lane], node.minY[lane], node.minZ[lane]));
+				bounds.extend(glm::vec3(node.maxX[lane], node.maxY[lane], node.maxZ[lane]));
+			}
+
+			return bounds;
+		}
+
+		void setLaneBounds(BvhNode& node, nbUint32 lane, const Aabb& bounds)
+		{
+			node.minX[lane] = bounds.min.x;
+			node.minY[lane] = bounds.min.y;
+			node.minZ[lane] = bounds.min.z;
+			node.maxX[lane] = bounds.max.x;
+			node.maxY[lane] = bounds.max.y;
+			node.maxZ[lane] = bounds.max.z;
+		}
+	}
+
+	TwoLevelBvh::TwoLevelBvh(const TwoLevelBvhSettings& settings)
+	: m_settings(settings)
+	{
+	}
+
+	nbUint32 TwoLevelBvh::addInstance(const BvhPtr& bvh, const glm::mat4& transform)
+	{
+		NEBULA_ASSERT(bvh);
+
+		m_instances.emplace_back();
+		m_instances.back().bvh = bvh;
+		setTransform((nbUint32)m_instances.size() - 1u, transform);
+
+		m_needsBuild = true;
+		return (nbUint32)m_instances.size() - 1u;
+	}
+
+	void TwoLevelBvh::setTransform(nbUint32 instanceIdx, const glm::mat4& transform)
+	{
+		BvhInstance& instance = m_instances[instanceIdx];
+		instance.transform = transform;
+		instance.invTransform = glm::inverse(transform);
+		instance.bounds = computeBounds(instance.bvh->getBounds(), transform);
+
+		m_needsRefit = true;
+	}
+
+	void TwoLevelBvh::clear()
+	{
+		m_instances.clear();
+		m_nodes.clear();
+
+		m_needsBuild = m_needsRefit = false;
+	}
+
+	void TwoLevelBvh::commit()
+	{
+		if (m_needsBuild)
+		{
+			build();
+		}
+		else if (m_needsRefit && !m_nodes.empty())
+		{
+			refit();
+			++m_nbRefits;
+
+			if (getNodeBounds(m_nodes[0]).getHalfArea() > m_settings.m_maxRefitGrowth * m_builtRootArea)
+				build();
+		}
+
+		m_needsBuild = m_needsRefit = false;
+	}
+
+	void TwoLevelBvh::build()
+	{
+		m_nodes.clear();
+
+		const nbUint32 nbInstances = (nbUint32)m_instances.size();
+		if (!nbInstances)
+			return;
+
+		m_instanceIds.resize(nbInstances);
+		std::iota(m_instanceIds.begin(), m_instanceIds.end(), 0u);
+
+		buildNode(0u, nbInstances);
+		refit();
+
+		m_builtRootArea = getNodeBounds(m_nodes[0]).getHalfArea();
+		++m_nbBuilds;
+	}
+
+	nbUint32 TwoLevelBvh::buildNode(nbUint32 begin, nbUint32 end)
+	{
+		const nbUint32 nodeIdx = (nbUint32)m_nodes.size();
+		m_nodes.emplace_back();
+
+		// Median splits of the largest group along its widest axis until the lanes are full.
+		// The top level only holds a few thousand instances at most, SAH brings little here.
+		std::pair<nbUint32, nbUint32> groups[BvhNode::Width];
+		nbUint32 nbGroups = 0u;
+		groups[nbGroups++] = { begin, end };
+
+		while (nbGroups < BvhNode::Width)
+		{
+			nbUint32 largest = 0u;
+			for (nbUint32 i = 1u; i < nbGroups; ++i)
+			{
+				if (groups[i].second - groups[i].first > groups[largest].second - groups[largest].first)
+					largest = i;
+			}
+
+			const nbUint32 first = groups[largest].first;
+			const nbUint32 last = groups[largest].second;
+			if (last - first < 2u)
+				break;
+
+			Aabb centroidBounds;
+			for (nbUint32 i = first; i < last; ++i)
+				centroidBounds.extend(m_instances[m_instanceIds[i]].bounds.getCenter());
+
+			const glm::vec3 extent = centroidBounds.getExtent();
+			const nbUint32 axis = extent.x >= extent.y && extent.x >= extent.z ? 0u : (extent.y >= extent.z ? 1u : 2u);
+
+			const nbUint32 mid = first + (last - first) / 2u;
+			std::nth_element(m_instanceIds.begin() + first, m_instanceIds.begin() + mid, m_instanceIds.begin() + last, [&](nbUint32 a, nbUint32 b)
+			{
+				return m_instances[a].bounds.getCenter()[axis] < m_instances[b].bounds.getCenter()[axis];
+			});
+
+			groups[largest].second = mid;
+			groups[nbGroups++] = { mid, last };
+		}
+
+		for (nbUint32 lane = 0u; lane < BvhNode::Width; ++lane)
+		{
+			nbUint32 child = BvhNode::EmptyChild;
+
+			if (lane < nbGroups)
+			{
+				if (groups[lane].second - groups[lane].first == 1u)
+					child = m_instanceIds[groups[lane].first] | BvhNode::LeafFlag;
+				else
+					child = buildNode(groups[lane].first, groups[lane].second);
+			}
+
+			// Bounds are set by refit.
+			setLaneBounds(m_nodes[nodeIdx], lane, Aabb());
+			m_nodes[nodeIdx].children[lane] = child;
+		}
+
+		return nodeIdx;
+	}
+
+	void TwoLevelBvh::refit()
+	{
+		// Children are stored after their parent, a reverse walk sees them first.
+		for (nbUint32 nodeIdx = (nbUint32)m_nodes.size(); nodeIdx-- > 0u;)
+		{
+			BvhNode& node = m_nodes[nodeIdx];
+
+			for (nbUint32 lane = 0u; lane < BvhNode::Width; ++lane)
+			{
+				const nbUint32 child = node.children[lane];
+				if (child == BvhNode::EmptyChild)
+					continue;
+
+				if (child & BvhNode::LeafFlag)
+					setLaneBounds(node, lane, m_instances[child & ~BvhNode::LeafFlag].bounds);
+				else
+					setLaneBounds(node, lane, getNodeBounds(m_nodes[child]));
+			}
+		}
+	}
+
+	Aabb TwoLevelBvh::computeBounds(const Aabb& objectBounds, const glm::mat4& transform)
+	{
+		Aabb bounds;
+		if (objectBounds.isEmpty())
+			return bounds;
+
+		for (nbUint32 corner = 0u; corner < 8u; ++corner)
+		{
+			const glm::vec3 point((corner & 1u) ? objectBounds.max.x : objectBounds.min.x,
+				(corner & 2u) ? objectBounds.max.y : objectBounds.min.y,
+				(corner & 4u) ? objectBounds.max.z : objectBounds.min.z);
+
+			bounds.extend(glm::vec3(transform * glm::vec4(point, 1.0f)));
+		}
+
+		return bounds;
+	}
+
+	nbBool TwoLevelBvh::intersect(const glm::vec3& origin, const glm::vec3& direction, nbFloat32 tMax, InstanceHit& dst) const
+	{
+		if (m_nodes.empty())
+			return false;
+
+		const glm::vec3 invDirection = getSafeInverse(direction);
+
+		BvhStackEntry stack[BvhStackSize];
+		nbUint32 stackSize = 0u;
+		stack[stackSize++] = { 0u, 0.0f };
+
+		nbFloat32 closest = tMax;
+		nbBool found = false;
+
+		while (stackSize)
+		{
+			const BvhStackEntry entry = stack[--stackSize];
+			if (entry.tNear >= closest)
+				continue;
+
+			if (entry.child & BvhNode::LeafFlag)
+			{
+				const nbUint32 instanceIdx = entry.child & ~BvhNode::LeafFlag;
+				const BvhInstance& instance = m_instances[instanceIdx];
+
+				// The object space direction is not normalized, so distances are the same in both spaces.
+				const glm::vec3 objectOrigin(instance.invTransform * glm::vec4(origin, 1.0f));
+				const glm::vec3 objectDirection(instance.invTransform * glm::vec4(direction, 0.0f));
+
+				BvhHit hit;
+				if (instance.bvh->intersect(objectOrigin, objectDirection, closest, hit))
+				{
+					closest = hit.t;
+					static_cast<BvhHit&>(dst) = hit;
+					dst.instanceIdx = instanceIdx;
+					found = true;
+				}
+
+				continue;
+			}
+
+			pushHitChildren(m_nodes[entry.child], origin, invDirection, closest, stack, stackSize);
+		}
+
+		return found;
+	}
+
+	nbFloat32 TwoLevelBvh::occlusion(const glm::vec3& origin, const glm::vec3& direction, nbFloat32 tMax) const
+	{
+		if (m_nodes.empty())
+			return 0.0f;
+
+		const glm::vec3 invDirection = getSafeInverse(direction);
+
+		const nbBool lowSideFirst = isLowSideFirst(direction);
+
+		BvhStackEntry stack[BvhStackSize];
+		nbUint32 stackSize = 0u;
+		stack[stackSize++] = { 0u, 0.0f };
+
+		nbFloat32 transmittance = 1.0f;
+
+		while (stackSize)
+		{
+			const BvhStackEntry entry = stack[--stackSize];
+
+			if (entry.child & BvhNode::LeafFlag)
+			{
+				const BvhInstance& instance = m_instances[entry.child & ~BvhNode::LeafFlag];
+
+				const glm::vec3 objectOrigin(instance.invTransform * glm::vec4(origin, 1.0f));
+				const glm::vec3 objectDirection(instance.invTransform * glm::vec4(direction, 0.0f));
+
+				transmittance *= 1.0f - instance.bvh->occlusion(objectOrigin, objectDirection, tMax);
+				if (transmittance <= 0.0f)
+					return 1.0f;
+
+				continue;
+			}
+
+			pushHitChildrenBySign(m_nodes[entry.child], origin, invDirection, tMax, lowSideFirst, stack, stackSize);
+		}
+
+		return 1.0f - transmittance;
+	}
+
+	void TwoLevelBvh::intersect(const BvhRayStream& rays, InstanceHitStream& dst) const
+	{
+		for (nbUint32 rayIdx = 0u; rayIdx < rays.size; ++rayIdx)
+		{
+			if (rays.active && !rays.active[rayIdx])
+				continue;
+
+			const glm::vec3 origin(rays.originX[rayIdx], rays.originY[rayIdx], rays.originZ[rayIdx]);
+			const glm::vec3 direction(rays.directionX[rayIdx], rays.directionY[rayIdx], rays.directionZ[rayIdx]);
+
+			InstanceHit hit;
+			const nbBool found = intersect(origin, direction, rays.tMax[rayIdx], hit);
+			dst.hit[rayIdx] = found ? 1u : 0u;
+
+			if (found)
+			{
+				dst.t[rayIdx] = hit.t;
+				dst.u[rayIdx] = hit.u;
+				dst.v[rayIdx] = hit.v;
+				dst.primIdx[rayIdx] = hit.primIdx;
+				dst.instanceIdx[rayIdx] = hit.instanceIdx;
+			}
+		}
+	}
+
+	void TwoLevelBvh::occlusion(const BvhRayStream& rays, nbFloat32* dst) const
+	{
+		for (nbUint32 rayIdx = 0u; rayIdx < rays.size; ++rayIdx)
+		{
+			if (rays.active && !rays.active[rayIdx])
+				continue;
+
+			const glm::vec3 origin(rays.originX[rayIdx], rays.originY[rayIdx], rays.originZ[rayIdx]);
+			const glm::vec3 direction(rays.directionX[rayIdx], rays.directionY[rayIdx], rays.directionZ[rayIdx]);
+
+			dst[rayIdx] = occlusion(origin, direction, rays.tMax[rayIdx]);
+		}
+	}
+
+}}}}
\ No newline at end of file
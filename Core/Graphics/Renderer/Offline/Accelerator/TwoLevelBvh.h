@@ -0,0 +1,124 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include "Bvh.h"
+#include <memory>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Accelerator
+{
+using BvhPtr = std::shared_ptr<const Bvh>;
+
+struct BvhInstance
+{
+	// Bottom level bvh in object space. Shared by all the instances of a mesh.
+	BvhPtr bvh;
+
+	glm::mat4 transform;
+	glm::mat4 invTransform;
+
+	// World space bounds of the transformed bvh.
+	Aabb bounds;
+};
+
+struct InstanceHit : BvhHit
+{
+	nbUint32 instanceIdx;
+};
+
+struct InstanceHitStream : BvhHitStream
+{
+	nbUint32* instanceIdx = nullptr;
+};
+
+struct TwoLevelBvhSettings
+{
+	// On commit, the top level is rebuilt instead of refit when its root area grew by more than this factor
+	// since the last build. Refit nodes of instances moved far apart overlap and slow down the traversal.
+	nbFloat32 m_maxRefitGrowth = 2.0f;
+};
+
+// Two level acceleration structure. Each mesh has a bottom level bvh built once in object space
+// and instanced with a transform. The top level bvh over the instances bounds is small, it is refit
+// when transforms change and only rebuilt when instances are added or the refit degraded too much.
+// Instances do not copy geometry, so a mesh repeated many times costs a single bottom level bvh.
+//
+// Editing (addInstance, setTransform, commit) must not run while rays are traced.
+class TwoLevelBvh
+{
+public:
+	explicit TwoLevelBvh(const TwoLevelBvhSettings& settings = TwoLevelBvhSettings());
+
+	// Returns the instance index, used by setTransform and reported by hits.
+	nbUint32 addInstance(const BvhPtr& bvh, const glm::mat4& transform);
+	void setTransform(nbUint32 instanceIdx, const glm::mat4& transform);
+	void clear();
+
+	// Applies the pending edits to the top level.
+	void commit();
+
+	// Closest hit in ]0, tMax[. The hit distance is in world space.
+	nbBool intersect(const glm::vec3& origin, const glm::vec3& direction, nbFloat32 tMax, InstanceHit& dst) const;
+
+	// Fraction of the light blocked along ]0, tMax[. @See: Bvh::occlusion.
+	nbFloat32 occlusion(const glm::vec3& origin, const glm::vec3& direction, nbFloat32 tMax) const;
+
+	// Stream versions. @See: Bvh::intersect. The instance transforms split packets apart,
+	// so active rays walk the top level one by one.
+	void intersect(const BvhRayStream& rays, InstanceHitStream& dst) const;
+	void occlusion(const BvhRayStream& rays, nbFloat32* dst) const;
+
+	nbUint32 getNbInstances() const;
+	const BvhInstance& getInstance(nbUint32 instanceIdx) const;
+
+	nbUint32 getNbBuilds() const;
+	nbUint32 getNbRefits() const;
+
+private:
+	void build();
+	nbUint32 buildNode(nbUint32 begin, nbUint32 end);
+	void refit();
+
+	static Aabb computeBounds(const Aabb& objectBounds, const glm::mat4& transform);
+
+	TwoLevelBvhSettings m_settings;
+
+	std::vector<BvhInstance> m_instances;
+
+	// Top level nodes. Leaf children are instance indices.
+	Bvh::NodeArray m_nodes;
+	std::vector<nbUint32> m_instanceIds;
+
+	nbBool m_needsBuild = false;
+	nbBool m_needsRefit = false;
+	nbFloat32 m_builtRootArea = 0.0f;
+
+	nbUint32 m_nbBuilds = 0u;
+	nbUint32 m_nbRefits = 0u;
+};
+
+inline nbUint32 TwoLevelBvh::getNbInstances() const
+{
+	return (nbUint32)m_instances.size();
+}
+
+inline const BvhInstance& TwoLevelBvh::getInstance(nbUint32 instanceIdx) const
+{
+	return m_instances[instanceIdx];
+}
+
+inline nbUint32 TwoLevelBvh::getNbBuilds() const
+{
+	return m_nbBuilds;
+}
+
+inline nbUint32 TwoLevelBvh::getNbRefits() const
+{
+	return m_nbRefits;
+}
+}}}}
\ No newline at end of file
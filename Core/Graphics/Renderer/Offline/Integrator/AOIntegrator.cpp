@@ -7,17 +7,19 @@
 
 #include "stdafx.h"
 #include "AOIntegrator.h"
+#include "RayPacket.h"
 #include "Math/Generator/RandomPrimitiveSampleGenerator.h"
 
 namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
 {
 	nbFloat32 AOIntegrator::sample(const Intersector::BaseIntersectorPtr& intersector,
 		const IntersectionProperties& isectProps,
-		nbBool useDistanceMode)
+		nbBool useDistanceMode,
+		SampleStream& stream)
 	{
 		// Perform one ao sample
-		const nbFloat32 r1 = s_nbGenerator.generateSignedNormalized();
-		const nbFloat32 r2 = s_nbGenerator.generateUnsignedNormalized();
+		const nbFloat32 r1 = stream.generateSignedNormalized();
+		const nbFloat32 r2 = stream.generateUnsignedNormalized();
 		glm::vec3 aoSample = Math::uniformSphericalSample(r1, r2);
 
 		nbFloat32 NoL = glm::dot(isectProps.N, aoSample);
@@ -46,4 +48,69 @@ namespace Graphics { namespace Renderer { namespace Offline { namespace Integrat
 		return (1.0f - occlusionStrength) * NoL;
 	}
 
+	nbFloat32 AOIntegrator::sampleN(const Intersector::BaseIntersectorPtr& intersector,
+		const IntersectionProperties& isectProps,
+		nbUint32 n,
+		nbBool useDistanceMode,
+		SampleStream& stream)
+	{
+		if (n == 0u)
+			return 0.0f;
+
+		// Fibonacci lattice: u2 is stratified in n strata of equal size and u1 steps by the golden ratio,
+		// so the samples cover the sphere without gaps for any n. The random shift of u1 keeps the estimator unbiased.
+		const nbFloat32 goldenRatio = 0.618033988749895f;
+		const nbFloat32 shift = stream.generateUnsignedNormalized();
+
+		RayPacket packet;
+		packet.origin = isectProps.deltaP;
+
+		nbFloat32 NoLs[RayPacket::MaxSize];
+		nbFloat32 results[RayPacket::MaxSize];
+
+		nbFloat32 accAO = 0.0f;
+		for (nbUint32 start = 0u; start < n; start += RayPacket::MaxSize)
+		{
+			packet.size = std::min(RayPacket::MaxSize, n - start);
+
+			for (nbUint32 i = 0u; i < packet.size; ++i)
+			{
+				const nbUint32 sampleIdx = start + i;
+
+				nbFloat32 u1 = shift + sampleIdx * goldenRatio;
+				u1 -= std::floor(u1);
+				const nbFloat32 u2 = (sampleIdx + stream.generateUnsignedNormalized()) / n;
+
+				glm::vec3 aoSample = Math::uniformSphericalSample(u1 * 2.0f - 1.0f, u2);
+
+				nbFloat32 NoL = glm::dot(isectProps.N, aoSample);
+				if (NoL < 0.0f)
+				{
+					NoL *= -1.0f;
+					aoSample *= -1.0f;
+				}
+
+				packet.directions[i] = aoSample;
+				NoLs[i] = NoL;
+			}
+
+			if (useDistanceMode)
+			{
+				intersectDistance(intersector, packet, results);
+
+				for (nbUint32 i = 0u; i < packet.size; ++i)
+					accAO += (1.0f - std::exp(-results[i])) * NoLs[i];
+			}
+			else
+			{
+				occlusion(intersector, packet, results);
+
+				for (nbUint32 i = 0u; i < packet.size; ++i)
+					accAO += (1.0f - results[i]) * NoLs[i];
+			}
+		}
+
+		return accAO / n;
+	}
+
 }}}}
\ No newline at end of file
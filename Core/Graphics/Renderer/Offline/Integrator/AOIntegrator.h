@@ -15,6 +15,14 @@ struct AOIntegrator : public BaseIntegrator
 {
 	static nbFloat32 sample(const Intersector::BaseIntersectorPtr& intersector,
 		const IntersectionProperties& isectProps,
-		nbBool useDistanceMode);
+		nbBool useDistanceMode,
+		SampleStream& stream);
+
+	// Average of n stratified ao samples, submitted as ray packets.
+	static nbFloat32 sampleN(const Intersector::BaseIntersectorPtr& intersector,
+		const IntersectionProperties& isectProps,
+		nbUint32 n,
+		nbBool useDistanceMode,
+		SampleStream& stream);
 };
 }}}}
\ No newline at end of file
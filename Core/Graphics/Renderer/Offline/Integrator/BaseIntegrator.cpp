@@ -1,14 +0,0 @@
-//========================================================================
-// Copyright (c) Yann Clotioloman Yeo, 2018
-//
-//	Author					: Yann Clotioloman Yeo
-//	E-Mail					: nebularender@gmail.com
-//========================================================================
-
-#include "stdafx.h"
-#include "BaseIntegrator.h"
-
-namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
-{
-	Math::Generator::RandomNumberGenerator<nbFloat32> BaseIntegrator::s_nbGenerator;
-}}}}
\ No newline at end of file
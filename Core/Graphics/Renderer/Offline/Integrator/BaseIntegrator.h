@@ -8,15 +8,15 @@
 #pragma once
 
 #include "Helpers.h"
+#include "SampleStream.h"
 #include "Scene/BaseScene.h"
 #include "../Intersector/BaseIntersector.h"
-#include <atomic>
 
 namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
 {
+// Integrators are stateless.
+// Random numbers are drawn from the SampleStream of the pixel sample being integrated.
 struct BaseIntegrator
 {
-protected:
-	static Math::Generator::RandomNumberGenerator<nbFloat32> s_nbGenerator;
 };
 }}}}
\ No newline at end of file
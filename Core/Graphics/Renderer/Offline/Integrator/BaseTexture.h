@@ -0,0 +1,67 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include <cmath>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+// MIP mapped texture read while shading. Texels are normalized RGBA.
+class BaseTexture
+{
+public:
+	virtual ~BaseTexture() = default;
+
+	// Nearest texels of the two levels around lod, linearly blended.
+	virtual glm::vec4 getNormalizedPixelFromRatio(const glm::vec2& ratio, nbFloat32 lod) const = 0;
+
+	virtual nbUint32 getWidth() const = 0;
+	virtual nbUint32 getHeight() const = 0;
+	virtual nbUint32 getNbLevels() const = 0;
+
+	// Level whose texels have the size of a footprint given in texture coordinates units.
+	nbFloat32 computeLod(nbFloat32 uvFootprint) const;
+};
+
+inline nbFloat32 BaseTexture::computeLod(nbFloat32 uvFootprint) const
+{
+	const nbFloat32 texelFootprint = uvFootprint * std::sqrt((nbFloat32)getWidth() * (nbFloat32)getHeight());
+	return texelFootprint > 1.0f ? std::log2(texelFootprint) : 0.0f;
+}
+
+// Spreads the 16 low bits of v over the even bits.
+inline nbUint32 spreadBits(nbUint32 v)
+{
+	v &= 0x0000ffffu;
+	v = (v | (v << 8u)) & 0x00ff00ffu;
+	v = (v | (v << 4u)) & 0x0f0f0f0fu;
+	v = (v | (v << 2u)) & 0x33333333u;
+	v = (v | (v << 1u)) & 0x55555555u;
+	return v;
+}
+
+// Texels are stored as RGBA8 in a nbUint32, red in the low byte.
+inline glm::vec4 unpackTexel(nbUint32 texel)
+{
+	static const nbFloat32 inv255 = 1.0f / 255.0f;
+	return glm::vec4((nbFloat32)(texel & 0xffu),
+		(nbFloat32)((texel >> 8u) & 0xffu),
+		(nbFloat32)((texel >> 16u) & 0xffu),
+		(nbFloat32)(texel >> 24u)) * inv255;
+}
+
+inline nbUint32 packTexel(const glm::vec4& color)
+{
+	const glm::vec4 clamped = glm::clamp(color, 0.0f, 1.0f);
+
+	return (nbUint32)(clamped.r * 255.0f + 0.5f) |
+		((nbUint32)(clamped.g * 255.0f + 0.5f) << 8u) |
+		((nbUint32)(clamped.b * 255.0f + 0.5f) << 16u) |
+		((nbUint32)(clamped.a * 255.0f + 0.5f) << 24u);
+}
+}}}}
@@ -0,0 +1,145 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+// Standalone executable, not part of the Core library.
+// Compares the fast math kernels against libm, on accuracy over the whole clamped range
+// and on speed over the transmittances of a volume march.
+// Build it once per NEBULA_FAST_MATH_POLICY and instruction set to compare the paths.
+
+#include "stdafx.h"
+#include "../FastMath.h"
+#include "../Spectrum.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace Graphics::Renderer::Offline::Integrator;
+
+namespace
+{
+	const nbUint32 NbAccuracySamples = 1u << 24;
+	const nbUint32 NbSpeedValues = 1u << 20;
+	const nbUint32 NbSpeedRuns = 32u;
+
+	// Keeps the compiler from removing the timed loops.
+	volatile nbFloat32 s_sink = 0.0f;
+
+	nbFloat32 getRelativeError(nbFloat32 value, nbFloat64 reference)
+	{
+		return (nbFloat32)(std::abs(value - reference) / reference);
+	}
+
+	template <typename Func>
+	nbFloat64 measureNsPerValue(const Func& func)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (nbUint32 i = 0u; i < NbSpeedRuns; ++i)
+			func();
+		const auto end = std::chrono::high_resolution_clock::now();
+
+		return std::chrono::duration<nbFloat64, std::nano>(end - start).count() / ((nbFloat64)NbSpeedRuns * NbSpeedValues);
+	}
+
+	void checkAccuracy()
+	{
+		using namespace FastMathDetail;
+
+		nbFloat32 maxScalarError = 0.0f;
+		nbFloat32 maxSseError = 0.0f;
+		nbFloat32 maxLibmError = 0.0f;
+
+		const nbFloat32 step = (Exp2Max - Exp2Min) / NbAccuracySamples;
+		for (nbUint32 i = 0u; i < NbAccuracySamples; i += 4u)
+		{
+			alignas(16) nbFloat32 x[4];
+			for (nbUint32 j = 0u; j < 4u; ++j)
+				x[j] = Exp2Min + (i + j) * step;
+
+			alignas(16) nbFloat32 sse[4];
+			_mm_store_ps(sse, fastExp2(_mm_load_ps(x)));
+
+			for (nbUint32 j = 0u; j < 4u; ++j)
+			{
+				const nbFloat64 reference = std::exp2((nbFloat64)x[j]);
+				maxScalarError = std::max(maxScalarError, getRelativeError(fastExp2(x[j]), reference));
+				maxSseError = std::max(maxSseError, getRelativeError(sse[j], reference));
+				maxLibmError = std::max(maxLibmError, getRelativeError(std::exp2f(x[j]), reference));
+			}
+		}
+
+		std::printf("Max relative error over [%g, %g]\n", Exp2Min, Exp2Max);
+		std::printf("  std::exp2f       %.3e\n", maxLibmError);
+		std::printf("  fastExp2 scalar  %.3e\n", maxScalarError);
+		std::printf("  fastExp2 __m128  %.3e\n", maxSseError);
+	}
+
+	void checkSpeed()
+	{
+		// Transmittances of march steps, as computed by VolumeIntegrator.
+		std::mt19937 generator(42u);
+		std::uniform_real_distribution<nbFloat32> extinctions(0.01f, 2.0f);
+		std::uniform_real_distribution<nbFloat32> distances(0.0f, 50.0f);
+
+		std::vector<nbFloat32> stepDistances(NbSpeedValues);
+		std::vector<nbFloat32> src(NbSpeedValues);
+		for (nbUint32 i = 0u; i < NbSpeedValues; ++i)
+		{
+			stepDistances[i] = distances(generator);
+			src[i] = -extinctions(generator) * stepDistances[i];
+		}
+
+		std::vector<nbFloat32> dst(NbSpeedValues);
+
+		const nbFloat64 libmTime = measureNsPerValue([&]()
+		{
+			for (nbUint32 i = 0u; i < NbSpeedValues; ++i)
+				dst[i] = std::exp2f(src[i]);
+			s_sink = dst[NbSpeedValues / 2u];
+		});
+
+		const nbFloat64 scalarTime = measureNsPerValue([&]()
+		{
+			for (nbUint32 i = 0u; i < NbSpeedValues; ++i)
+				dst[i] = fastExp2(src[i]);
+			s_sink = dst[NbSpeedValues / 2u];
+		});
+
+		const nbFloat64 arrayTime = measureNsPerValue([&]()
+		{
+			fastExp2(src.data(), dst.data(), NbSpeedValues);
+			s_sink = dst[NbSpeedValues / 2u];
+		});
+
+		// One spectrum per value, three channels each.
+		const nbFloat64 spectrumTime = measureNsPerValue([&]()
+		{
+			PackedSpectrum acc;
+			const PackedSpectrum extinction(Spectrum(0.5f, 1.0f, 1.5f));
+
+			for (nbUint32 i = 0u; i < NbSpeedValues; ++i)
+				acc += computeTransmittance(extinction, stepDistances[i]);
+			s_sink = getLuminance(acc);
+		});
+
+		std::printf("Speed over %u march steps, ns per value\n", NbSpeedValues);
+		std::printf("  std::exp2f                   %.3f\n", libmTime);
+		std::printf("  fastExp2 scalar              %.3f\n", scalarTime);
+		std::printf("  fastExp2 array               %.3f\n", arrayTime);
+		std::printf("  computeTransmittance (rgb)   %.3f\n", spectrumTime);
+	}
+}
+
+int main()
+{
+	std::printf("NEBULA_FAST_MATH_POLICY %d\n", NEBULA_FAST_MATH_POLICY);
+
+	checkAccuracy();
+	checkSpeed();
+
+	return 0;
+}
\ No newline at end of file
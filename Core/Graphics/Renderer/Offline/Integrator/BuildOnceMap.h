@@ -0,0 +1,82 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include "tbb/collaborative_call_once.h"
+#include "tbb/concurrent_unordered_map.h"
+#include <functional>
+#include <memory>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+// Concurrent map of values built once, by the first thread looking up their key.
+// For values expensive to build: the other threads looking up a key being built wait for it instead of building
+// a copy, and help with the tbb parallel work of the builder meanwhile, so a builder using tbb cannot deadlock them.
+// @See: tbb::collaborative_call_once
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class BuildOnceMap
+{
+public:
+	// build returns the value of key. It runs at most once per key, unless it throws.
+	template <typename BuildFunc>
+	const Value& getOrBuild(const Key& key, const BuildFunc& build);
+
+	// Not thread safe, never call them while the map is read.
+	void clear();
+	void erase(const Key& key);
+
+	nbUint32 size() const;
+
+private:
+	struct Entry
+	{
+		tbb::collaborative_once_flag flag;
+		Value value;
+	};
+
+	tbb::concurrent_unordered_map<Key, std::unique_ptr<Entry>, Hash> m_entries;
+};
+
+template <typename Key, typename Value, typename Hash>
+template <typename BuildFunc>
+const Value& BuildOnceMap<Key, Value, Hash>::getOrBuild(const Key& key, const BuildFunc& build)
+{
+	auto entryIt = m_entries.find(key);
+	if (entryIt == m_entries.end())
+	{
+		// Entries are empty until built, a thread losing the insertion race only frees an empty one.
+		entryIt = m_entries.insert(std::make_pair(key, std::make_unique<Entry>())).first;
+	}
+
+	Entry& entry = *entryIt->second;
+	tbb::collaborative_call_once(entry.flag, [&]()
+	{
+		entry.value = build();
+	});
+
+	return entry.value;
+}
+
+template <typename Key, typename Value, typename Hash>
+inline void BuildOnceMap<Key, Value, Hash>::clear()
+{
+	m_entries.clear();
+}
+
+template <typename Key, typename Value, typename Hash>
+inline void BuildOnceMap<Key, Value, Hash>::erase(const Key& key)
+{
+	m_entries.unsafe_erase(key);
+}
+
+template <typename Key, typename Value, typename Hash>
+inline nbUint32 BuildOnceMap<Key, Value, Hash>::size() const
+{
+	return (nbUint32)m_entries.size();
+}
+}}}}
\ No newline at end of file
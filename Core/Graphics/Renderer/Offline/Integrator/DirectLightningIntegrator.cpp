@@ -10,46 +10,114 @@
 
 namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
 {
-	Spectrum DirectLightningIntegrator::sample(const EntityIdentifierArray& lights,
+	Spectrum DirectLightningIntegrator::sample(const LightSnapshot& lights,
 		const Intersector::BaseIntersectorPtr& intersector,
 		const Material::BaseMaterial& material,
 		const Material::BaseMaterial::BaseColorCachePtr& colorCache,
-		const IntersectionProperties& isectProps)
+		const IntersectionProperties& isectProps,
+		SampleStream& stream)
 	{
 		Spectrum outDirect = BlackRGBSpectrum;
 
-		for (const auto& lightId : lights)
+		for (nbUint32 i = 0u; i < lights.size(); ++i)
+			outDirect += sampleLight(lights, i, intersector, material, colorCache, isectProps, stream);
+
+		return outDirect;
+	}
+
+	Spectrum DirectLightningIntegrator::sample(const LightSampler& lightSampler,
+		nbUint32 nbLightSamples,
+		const Intersector::BaseIntersectorPtr& intersector,
+		const Material::BaseMaterial& material,
+		const Material::BaseMaterial::BaseColorCachePtr& colorCache,
+		const IntersectionProperties& isectProps,
+		SampleStream& stream)
+	{
+		const auto& lights = lightSampler.getLights();
+		if (nbLightSamples == 0u || nbLightSamples >= lights.size())
+			return sample(lights, intersector, material, colorCache, isectProps, stream);
+
+		Spectrum outDirect = BlackRGBSpectrum;
+
+		for (nbUint32 i = 0u; i < nbLightSamples; ++i)
 		{
-			const auto light = Entity::EntityDatabaseSingleton::instance()->getEntity<Light::BaseLight>(lightId);
+			const LightPick pick = lightSampler.pick(stream);
+			outDirect += sampleLight(lights, pick.lightIdx, intersector, material, colorCache, isectProps, stream) / pick.pdf;
+		}
+
+		return outDirect / (nbFloat32)nbLightSamples;
+	}
+
+	Spectrum DirectLightningIntegrator::sampleLight(const LightSnapshot& lights,
+		nbUint32 lightIdx,
+		const Intersector::BaseIntersectorPtr& intersector,
+		const Material::BaseMaterial& material,
+		const Material::BaseMaterial::BaseColorCachePtr& colorCache,
+		const IntersectionProperties& isectProps,
+		SampleStream& stream)
+	{
+		const auto sampleToLight = lights.getLight(lightIdx).generateSampleToLight(stream, isectProps.P);
+		if (!sampleToLight.canProcess)
+			return BlackRGBSpectrum;
 
-			const auto sampleToLight = light->generateSampleToLight(s_nbGenerator, isectProps.P);
-			if (!sampleToLight.canProcess)
-				continue;
+		const nbFloat32 NoL = glm::dot(isectProps.N, sampleToLight.L);
+		if (NoL <= 0.0f)
+			return BlackRGBSpectrum;
 
-			const nbFloat32 NoL = glm::dot(isectProps.N, sampleToLight.L);
-			if (NoL <= 0.0f)
-				continue;
+		// Visibility first, the bsdf is not evaluated for fully occluded lights.
+		Math::Ray sRay(isectProps.deltaP, sampleToLight.L, sampleToLight.length);
+		const nbFloat32 occlusionStrength = intersector->occlusion(sRay);
 
-			Math::Ray sRay(isectProps.deltaP, sampleToLight.L, sampleToLight.length);
-			const nbFloat32 occlusionStrength = intersector->occlusion(sRay);
+		if (occlusionStrength == 1.0f)
+			return BlackRGBSpectrum;
 
-			if (occlusionStrength != 1.0f)
-			{
-				// Sample the brdf to get the scale
-				auto sampledBrdf = material.sampleBsdf(colorCache, sampleToLight.L, isectProps.V, isectProps.N, NoL, false);
+		auto contribution = computeContribution(lights, lightIdx, material, colorCache, isectProps, sampleToLight.L, NoL);
 
-				// Multiply by light radiance
-				sampledBrdf *= light->getFinalColor();
+		// Multiply by visibility
+		contribution *= (1.0f - occlusionStrength);
 
-				// Multiply by visibility
-				sampledBrdf *= (1.0f - occlusionStrength);
+		return contribution;
+	}
 
-				// Finally add light contribution
-				outDirect += sampledBrdf;
-			}
-		}
+	nbBool DirectLightningIntegrator::generateShadowRay(const LightSnapshot& lights,
+		nbUint32 lightIdx,
+		const Material::BaseMaterial& material,
+		const Material::BaseMaterial::BaseColorCachePtr& colorCache,
+		const IntersectionProperties& isectProps,
+		SampleStream& stream,
+		ShadowRay& dst)
+	{
+		const auto sampleToLight = lights.getLight(lightIdx).generateSampleToLight(stream, isectProps.P);
+		if (!sampleToLight.canProcess)
+			return false;
 
-		return outDirect;
+		const nbFloat32 NoL = glm::dot(isectProps.N, sampleToLight.L);
+		if (NoL <= 0.0f)
+			return false;
+
+		dst.origin = isectProps.deltaP;
+		dst.direction = sampleToLight.L;
+		dst.length = sampleToLight.length;
+		dst.contribution = computeContribution(lights, lightIdx, material, colorCache, isectProps, sampleToLight.L, NoL);
+
+		return true;
+	}
+
+	Spectrum DirectLightningIntegrator::computeContribution(const LightSnapshot& lights,
+		nbUint32 lightIdx,
+		const Material::BaseMaterial& material,
+		const Material::BaseMaterial::BaseColorCachePtr& colorCache,
+		const IntersectionProperties& isectProps,
+		const glm::vec3& L,
+		nbFloat32 NoL)
+	{
+		// Sample the brdf to get the scale
+		auto sampledBrdf = material.sampleBsdf(colorCache, L, isectProps.V, isectProps.N, NoL, false);
+
+		// Multiply by light radiance
+		sampledBrdf *= lights.getColor(lightIdx);
+
+		return sampledBrdf;
 	}
 
-}}}}
+}}}}
\ No newline at end of file
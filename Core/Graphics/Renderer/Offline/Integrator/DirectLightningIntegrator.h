@@ -8,15 +8,65 @@
 #pragma once
 
 #include "BaseIntegrator.h"
+#include "LightSampler.h"
 
 namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
 {
+// Light contribution waiting for its visibility test.
+struct ShadowRay
+{
+	glm::vec3 origin;
+	glm::vec3 direction;
+	nbFloat32 length;
+	Spectrum contribution;
+};
+
 struct DirectLightningIntegrator : BaseIntegrator
 {
-	static Spectrum sample(const EntityIdentifierArray& lights,
+	static Spectrum sample(const LightSnapshot& lights,
 		const Intersector::BaseIntersectorPtr& intersector,
 		const Material::BaseMaterial& material,
 		const Material::BaseMaterial::BaseColorCachePtr& colorCache,
-		const IntersectionProperties& isectProps);
+		const IntersectionProperties& isectProps,
+		SampleStream& stream);
+
+	// Estimate from nbLightSamples lights picked by the light sampler.
+	// All the lights are processed when there are no more lights than samples.
+	static Spectrum sample(const LightSampler& lightSampler,
+		nbUint32 nbLightSamples,
+		const Intersector::BaseIntersectorPtr& intersector,
+		const Material::BaseMaterial& material,
+		const Material::BaseMaterial::BaseColorCachePtr& colorCache,
+		const IntersectionProperties& isectProps,
+		SampleStream& stream);
+
+	// Unoccluded contribution of a light and the ray testing its visibility, for callers tracing shadow rays in bulk.
+	// The bsdf is evaluated before the visibility is known, sample() traces the shadow ray first instead.
+	// Returns false when the light does not contribute.
+	static nbBool generateShadowRay(const LightSnapshot& lights,
+		nbUint32 lightIdx,
+		const Material::BaseMaterial& material,
+		const Material::BaseMaterial::BaseColorCachePtr& colorCache,
+		const IntersectionProperties& isectProps,
+		SampleStream& stream,
+		ShadowRay& dst);
+
+private:
+	static Spectrum sampleLight(const LightSnapshot& lights,
+		nbUint32 lightIdx,
+		const Intersector::BaseIntersectorPtr& intersector,
+		const Material::BaseMaterial& material,
+		const Material::BaseMaterial::BaseColorCachePtr& colorCache,
+		const IntersectionProperties& isectProps,
+		SampleStream& stream);
+
+	// Light radiance scaled by the bsdf.
+	static Spectrum computeContribution(const LightSnapshot& lights,
+		nbUint32 lightIdx,
+		const Material::BaseMaterial& material,
+		const Material::BaseMaterial::BaseColorCachePtr& colorCache,
+		const IntersectionProperties& isectProps,
+		const glm::vec3& L,
+		nbFloat32 NoL);
 };
 }}}}
\ No newline at end of file
@@ -0,0 +1,31 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#include "stdafx.h"
+#include "FastMath.h"
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+	void fastExp2(const nbFloat32* src, nbFloat32* dst, nbUint32 count)
+	{
+		nbUint32 i = 0u;
+
+#if NEBULA_FAST_MATH_POLICY == NEBULA_FAST_MATH_AVX2
+		for (; i + 8u <= count; i += 8u)
+			_mm256_storeu_ps(dst + i, fastExp2(_mm256_loadu_ps(src + i)));
+#endif
+
+#if NEBULA_FAST_MATH_POLICY != NEBULA_FAST_MATH_LIBM
+		for (; i + 4u <= count; i += 4u)
+			_mm_storeu_ps(dst + i, fastExp2(_mm_loadu_ps(src + i)));
+#endif
+
+		for (; i < count; ++i)
+			dst[i] = fastExp2(src[i]);
+	}
+
+}}}}
@@ -0,0 +1,147 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+
+// Implementation used by the fast math kernels. Define NEBULA_FAST_MATH_POLICY to force one.
+// The AVX2 kernel uses FMA, which is a separate instruction set. It is only picked when both are enabled.
+#define NEBULA_FAST_MATH_LIBM 0
+#define NEBULA_FAST_MATH_SSE 1
+#define NEBULA_FAST_MATH_AVX2 2
+
+#ifndef NEBULA_FAST_MATH_POLICY
+	#if defined(__AVX2__) && defined(__FMA__)
+		#define NEBULA_FAST_MATH_POLICY NEBULA_FAST_MATH_AVX2
+	#else
+		#define NEBULA_FAST_MATH_POLICY NEBULA_FAST_MATH_SSE
+	#endif
+#endif
+
+#if NEBULA_FAST_MATH_POLICY == NEBULA_FAST_MATH_AVX2 && !(defined(__AVX2__) && defined(__FMA__))
+	#error "NEBULA_FAST_MATH_AVX2 requires AVX2 and FMA to be enabled"
+#endif
+
+#if NEBULA_FAST_MATH_POLICY == NEBULA_FAST_MATH_AVX2
+	#include <immintrin.h>
+#endif
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+// exp2 approximation. x = n + f with n integer and f in [-0.5, 0.5], 2^f is a degree 6 polynomial and 2^n is added to the exponent bits.
+// Maximum relative error is 1.2e-7 over [-126, 127], inputs outside are clamped. NaN is not handled.
+// @See: Cephes Mathematical Library, exp2f.c
+namespace FastMathDetail
+{
+	const nbFloat32 Exp2Min = -126.0f;
+	const nbFloat32 Exp2Max = 127.0f;
+
+	const nbFloat32 Exp2C0 = 1.535336188319500e-4f;
+	const nbFloat32 Exp2C1 = 1.339887440266574e-3f;
+	const nbFloat32 Exp2C2 = 9.618437357674640e-3f;
+	const nbFloat32 Exp2C3 = 5.550332471162809e-2f;
+	const nbFloat32 Exp2C4 = 2.402264791363012e-1f;
+	const nbFloat32 Exp2C5 = 6.931472028550421e-1f;
+}
+
+const nbFloat32 Log2e = 1.44269504f;
+
+inline nbFloat32 fastExp2(nbFloat32 x)
+{
+#if NEBULA_FAST_MATH_POLICY == NEBULA_FAST_MATH_LIBM
+	return std::exp2f(x);
+#else
+	using namespace FastMathDetail;
+
+	x = std::min(std::max(x, Exp2Min), Exp2Max);
+
+	const nbFloat32 n = std::nearbyint(x);
+	const nbFloat32 f = x - n;
+
+	nbFloat32 p = Exp2C0;
+	p = p * f + Exp2C1;
+	p = p * f + Exp2C2;
+	p = p * f + Exp2C3;
+	p = p * f + Exp2C4;
+	p = p * f + Exp2C5;
+	p = p * f + 1.0f;
+
+	nbInt32 bits;
+	std::memcpy(&bits, &p, sizeof(bits));
+	bits += (nbInt32)n << 23;
+	std::memcpy(&p, &bits, sizeof(p));
+
+	return p;
+#endif
+}
+
+// Under NEBULA_FAST_MATH_LIBM, calls std::exp2f per lane so packed users get libm results too.
+inline __m128 fastExp2(__m128 x)
+{
+#if NEBULA_FAST_MATH_POLICY == NEBULA_FAST_MATH_LIBM
+	alignas(16) nbFloat32 lanes[4];
+	_mm_store_ps(lanes, x);
+
+	for (nbUint32 i = 0u; i < 4u; ++i)
+		lanes[i] = std::exp2f(lanes[i]);
+
+	return _mm_load_ps(lanes);
+#else
+	using namespace FastMathDetail;
+
+	x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(Exp2Min)), _mm_set1_ps(Exp2Max));
+
+	// Round to nearest, the default MXCSR mode.
+	const __m128i n = _mm_cvtps_epi32(x);
+	const __m128 f = _mm_sub_ps(x, _mm_cvtepi32_ps(n));
+
+	__m128 p = _mm_set1_ps(Exp2C0);
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(Exp2C1));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(Exp2C2));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(Exp2C3));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(Exp2C4));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(Exp2C5));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.0f));
+
+	return _mm_castsi128_ps(_mm_add_epi32(_mm_castps_si128(p), _mm_slli_epi32(n, 23)));
+#endif
+}
+
+#if NEBULA_FAST_MATH_POLICY == NEBULA_FAST_MATH_AVX2
+inline __m256 fastExp2(__m256 x)
+{
+	using namespace FastMathDetail;
+
+	x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(Exp2Min)), _mm256_set1_ps(Exp2Max));
+
+	const __m256i n = _mm256_cvtps_epi32(x);
+	const __m256 f = _mm256_sub_ps(x, _mm256_cvtepi32_ps(n));
+
+	__m256 p = _mm256_set1_ps(Exp2C0);
+	p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(Exp2C1));
+	p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(Exp2C2));
+	p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(Exp2C3));
+	p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(Exp2C4));
+	p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(Exp2C5));
+	p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(1.0f));
+
+	return _mm256_castsi256_ps(_mm256_add_epi32(_mm256_castps_si256(p), _mm256_slli_epi32(n, 23)));
+}
+#endif
+
+inline nbFloat32 fastExp(nbFloat32 x)
+{
+	return fastExp2(x * Log2e);
+}
+
+// dst[i] = exp2(src[i]). src and dst may be the same array.
+void fastExp2(const nbFloat32* src, nbFloat32* dst, nbUint32 count);
+}}}}
@@ -11,7 +11,12 @@
 
 namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
 {
-	IntersectionProperties buildIntersectionProperties(const Math::Ray& ray, const Intersector::IntersectionInfo& info, const Scene::BaseScene* scene)
+	IntersectionProperties buildIntersectionProperties(const Math::Ray& ray,
+		const Intersector::IntersectionInfo& info,
+		const Scene::BaseScene* scene,
+		ShadingVertexCache* vertexCache,
+		TextureTable* textureTable,
+		const RayCone& rayCone)
 	{
 		const auto mesh = info.object;
 		const auto P = ray.getPoint(info.meshIntersectData.packetIntersectionResult.t);
@@ -22,19 +27,20 @@ namespace Graphics { namespace Renderer { namespace Offline { namespace Integrat
 		const nbUint32 triStartIdx = (NEBULA_INTRINSICS_NB_FLOAT * trianglePacketIdx + packedInternalIdx) * NEBULA_PRIMITIVE_NB_VTX;
 
 		NEBULA_ASSERT(NEBULA_PRIMITIVE_NB_VTX == 3u);
-		const auto v1 = mesh->buildTransformedVertexFromIndices(triStartIdx);
-		const auto v2 = mesh->buildTransformedVertexFromIndices(triStartIdx + 1);
-		const auto v3 = mesh->buildTransformedVertexFromIndices(triStartIdx + 2);
+		ShadingTriangle tri;
+		if (vertexCache)
+			vertexCache->fetch(mesh, triStartIdx, tri);
+		else
+			buildShadingTriangle(mesh, triStartIdx, tri);
 
 		// Compute barycentric interpolation weights
-		//see <-- https://en.wikibooks.org/wiki/GLSL_Programming/Rasterization ->
-		const auto& packedTriangles = mesh->getTrianglePackets()[trianglePacketIdx];
-		const nbFloat32 alpha1 = 0.5f * glm::length(glm::cross(v2.position - P, v3.position - P)) * packedTriangles.invArea[packedInternalIdx];
-		const nbFloat32 alpha2 = 0.5f * glm::length(glm::cross(v1.position - P, v3.position - P)) * packedTriangles.invArea[packedInternalIdx];
-		const nbFloat32 alpha3 = 0.5f * glm::length(glm::cross(v1.position - P, v2.position - P)) * packedTriangles.invArea[packedInternalIdx];
+		const glm::vec3 barycentrics = computeBarycentrics(P, tri.positions[0], tri.positions[1], tri.positions[2]);
+		const nbFloat32 alpha1 = barycentrics.x;
+		const nbFloat32 alpha2 = barycentrics.y;
+		const nbFloat32 alpha3 = barycentrics.z;
 
 		// Texture coordinates
-		auto texCoord = (v1.texCoord * alpha1) + (v2.texCoord * alpha2) + (v3.texCoord * alpha3);
+		auto texCoord = (tri.texCoords[0] * alpha1) + (tri.texCoords[1] * alpha2) + (tri.texCoords[2] * alpha3);
 		texCoord.s = std::abs(texCoord.s);
 		texCoord.t = std::abs(texCoord.t);
 
@@ -48,34 +54,65 @@ namespace Graphics { namespace Renderer { namespace Offline { namespace Integrat
 		// Eye vector
 		auto V = -ray.m_direction;
 
+		// Texture footprint, the cone width projected on the triangle and scaled by its texture density.
+		nbFloat32 uvFootprint = 0.0f;
+		if (rayCone.isValid())
+		{
+			const glm::vec3 worldCross = glm::cross(tri.positions[1] - tri.positions[0], tri.positions[2] - tri.positions[0]);
+			const glm::vec2 uvEdge1 = tri.texCoords[1] - tri.texCoords[0];
+			const glm::vec2 uvEdge2 = tri.texCoords[2] - tri.texCoords[0];
+
+			const nbFloat32 worldArea = glm::length(worldCross);
+			const nbFloat32 uvArea = std::abs(uvEdge1.x * uvEdge2.y - uvEdge1.y * uvEdge2.x);
+
+			if (worldArea > 0.0f && uvArea > 0.0f)
+			{
+				const nbFloat32 cosine = std::max(std::abs(glm::dot(worldCross, V)) / worldArea, 1e-2f);
+				const nbFloat32 width = rayCone.getWidthAt(info.meshIntersectData.packetIntersectionResult.t) / cosine;
+
+				uvFootprint = width * std::sqrt(uvArea / worldArea);
+			}
+		}
+
 		// Compute normal
-		auto N = (v1.normal * alpha1) + (v2.normal * alpha2) + (v3.normal * alpha3);
+		auto N = (tri.normals[0] * alpha1) + (tri.normals[1] * alpha2) + (tri.normals[2] * alpha3);
 
 		// Read model
 		const Model::ModelPtr& model = scene->getModel();
 
 		// Apply normal mapping
-		const Material::DatabaseMaterialPtr material = model->getMaterialFromEntityOrDefault(mesh->getMaterialId());
-		if (material->isFresnelMaterial())
+		auto applyNormalMap = [&](const glm::vec4& normalMapPixel)
 		{
-			const auto* fresnelMat = static_cast<const Material::FresnelMaterial*>(material.get());
-			const EntityIdentifier normalMapId = fresnelMat->getNormalImageId();
-			
-			if (normalMapId)
-			{
-				// Read bump map
-				const auto image = Texture::getRGBAImageFromEntity(normalMapId);
-				if (image)
-				{
-					const RGBAColor bumpMapNormal = image->getNormalizedPixelFromRatio(texCoord) * 2.0f - 1.0f;
+			const glm::vec3 bumpMapNormal = glm::vec3(normalMapPixel) * 2.0f - 1.0f;
+
+			// Tangent space matrix
+			const glm::vec3 tangent = (tri.tangents[0] * alpha1) + (tri.tangents[1] * alpha2) + (tri.tangents[2] * alpha3);
+			const glm::vec3 bitangent = (tri.bitangents[0] * alpha1) + (tri.bitangents[1] * alpha2) + (tri.bitangents[2] * alpha3);
+			const glm::mat3 tbn = glm::mat3(tangent, bitangent, N);
 
-					// Tangent space matrix
-					const glm::vec3 tangent = (v1.tangent * alpha1) + (v2.tangent * alpha2) + (v3.tangent * alpha3);
-					const glm::vec3 bitangent = (v1.bitangent * alpha1) + (v2.bitangent * alpha2) + (v3.bitangent * alpha3);
-					const glm::mat3 tbn = glm::mat3(tangent, bitangent, N);
+			// Bump mapped normal
+			N = tbn * bumpMapNormal;
+		};
+
+		if (textureTable)
+		{
+			if (const BaseTexture* normalMap = textureTable->getNormalMap(model, mesh->getMaterialId()))
+				applyNormalMap(normalMap->getNormalizedPixelFromRatio(texCoord, normalMap->computeLod(uvFootprint)));
+		}
+		else
+		{
+			const Material::DatabaseMaterialPtr material = model->getMaterialFromEntityOrDefault(mesh->getMaterialId());
+			if (material->isFresnelMaterial())
+			{
+				const auto* fresnelMat = static_cast<const Material::FresnelMaterial*>(material.get());
+				const EntityIdentifier normalMapId = fresnelMat->getNormalImageId();
 
-					// Bump mapped normal
-					N = tbn * glm::swizzle<glm::X, glm::Y, glm::Z>(bumpMapNormal);
+				if (normalMapId)
+				{
+					// Read bump map
+					const auto image = Texture::getRGBAImageFromEntity(normalMapId);
+					if (image)
+						applyNormalMap(image->getNormalizedPixelFromRatio(texCoord));
 				}
 			}
 		}
@@ -93,6 +130,7 @@ namespace Graphics { namespace Renderer { namespace Offline { namespace Integrat
 		props.V = V;
 		props.N = N;
 		props.texCoord = texCoord;
+		props.uvFootprint = uvFootprint;
 
 		return props;
 	}
@@ -7,7 +7,9 @@
 
 #pragma once
 
+#include "ShadingVertexCache.h"
 #include "Spectrum.h"
+#include "TextureTable.h"
 #include "Scene/BaseScene.h"
 #include "../Intersector/IntersectionInfo.h"
 #include "../Intersector/BaseIntersector.h"
@@ -25,6 +27,71 @@ inline glm::vec3 getOffsetedPositionInDirection(const glm::vec3& P, const glm::v
 	return P + (eps * D);
 }
 
+// Signed barycentric weights of P, assumed to lie in the triangle plane. The weights always sum to one.
+// Each weight is an edge function, a cross product projected on the triangle normal, so thin triangles keep
+// the precision of their edges. Once the intersector exports the u, v of its triangle test,
+// (1 - u - v, u, v) replaces this call.
+// @See: Christer Ericson, Real-Time Collision Detection, 3.4
+inline glm::vec3 computeBarycentrics(const glm::vec3& P, const glm::vec3& A, const glm::vec3& B, const glm::vec3& C)
+{
+	const glm::vec3 e0 = B - A;
+	const glm::vec3 e1 = C - A;
+	const glm::vec3 d = P - A;
+
+	const glm::vec3 n = glm::cross(e0, e1);
+	const nbFloat32 nn = glm::dot(n, n);
+	if (nn == 0.0f)
+		return glm::vec3(1.0f / 3.0f);
+
+	const nbFloat32 v = glm::dot(glm::cross(d, e1), n) / nn;
+	const nbFloat32 w = glm::dot(glm::cross(e0, d), n) / nn;
+
+	return glm::vec3(1.0f - v - w, v, w);
+}
+
+// Footprint of a ray, used to pick texture MIP levels.
+// Ray cones stand in for ray differentials: a width and a spread angle, without per axis derivatives.
+// @See: Akenine-Moller et al., Texture Level of Detail Strategies for Real-Time Ray Tracing, Ray Tracing Gems
+struct RayCone
+{
+	nbFloat32 width = 0.0f;
+	nbFloat32 spreadAngle = 0.0f;
+
+	// Camera rays. verticalFov in radians.
+	static RayCone fromPixel(nbFloat32 verticalFov, nbUint32 imageHeight);
+
+	// Cone of a secondary ray leaving the hit at distance t. surfaceSpreadAngle widens it further, e.g. on curved surfaces.
+	RayCone propagate(nbFloat32 t, nbFloat32 surfaceSpreadAngle = 0.0f) const;
+
+	nbFloat32 getWidthAt(nbFloat32 t) const;
+	nbBool isValid() const;
+};
+
+inline RayCone RayCone::fromPixel(nbFloat32 verticalFov, nbUint32 imageHeight)
+{
+	RayCone cone;
+	cone.spreadAngle = std::atan(2.0f * std::tan(verticalFov * 0.5f) / (nbFloat32)std::max(1u, imageHeight));
+	return cone;
+}
+
+inline RayCone RayCone::propagate(nbFloat32 t, nbFloat32 surfaceSpreadAngle) const
+{
+	RayCone cone;
+	cone.width = width + spreadAngle * t;
+	cone.spreadAngle = spreadAngle + surfaceSpreadAngle;
+	return cone;
+}
+
+inline nbFloat32 RayCone::getWidthAt(nbFloat32 t) const
+{
+	return std::abs(width + spreadAngle * t);
+}
+
+inline nbBool RayCone::isValid() const
+{
+	return width > 0.0f || spreadAngle > 0.0f;
+}
+
 struct IntersectionProperties
 {
 	glm::vec3 P;
@@ -33,9 +100,20 @@ struct IntersectionProperties
 	glm::vec3 V;
 	glm::vec3 N;
 	glm::vec2 texCoord;
+
+	// Side of the ray footprint in texture coordinates units. Zero without a ray cone.
+	nbFloat32 uvFootprint;
 };
 
-IntersectionProperties buildIntersectionProperties(const Math::Ray& ray, const Intersector::IntersectionInfo& info, const Scene::BaseScene* scene);
+// The caches are optional. Without them the hit triangle vertices are transformed
+// and the normal map is looked up in the entity database on every call.
+// The normal map is MIP filtered when the texture table and the ray cone are given.
+IntersectionProperties buildIntersectionProperties(const Math::Ray& ray,
+	const Intersector::IntersectionInfo& info,
+	const Scene::BaseScene* scene,
+	ShadingVertexCache* vertexCache = nullptr,
+	TextureTable* textureTable = nullptr,
+	const RayCone& rayCone = RayCone());
 
 Spectrum getSkyColor(const Scene::BaseScene* scene, const Math::Ray& ray, nbBool useSceneBackground = false);
 
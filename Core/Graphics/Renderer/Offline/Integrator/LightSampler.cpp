@@ -0,0 +1,87 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#include "stdafx.h"
+#include "LightSampler.h"
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+	LightSampler::LightSampler(const LightSnapshot& lights)
+	: m_lights(&lights)
+	{
+		const nbUint32 nbLights = lights.size();
+		if (!nbLights)
+			return;
+
+		// Weight each light by the luminance of its color.
+		m_pdfs.resize(nbLights);
+		nbFloat32 totalPower = 0.0f;
+
+		for (nbUint32 i = 0u; i < nbLights; ++i)
+		{
+			m_pdfs[i] = getLuminance(lights.getColor(i));
+			totalPower += m_pdfs[i];
+		}
+
+		for (nbFloat32& pdf : m_pdfs)
+			pdf = totalPower > 0.0f ? pdf / totalPower : 1.0f / nbLights;
+
+		// Vose alias method.
+		m_thresholds.resize(nbLights);
+		m_aliases.resize(nbLights);
+
+		std::vector<nbUint32> small, large;
+		for (nbUint32 i = 0u; i < nbLights; ++i)
+		{
+			m_thresholds[i] = m_pdfs[i] * nbLights;
+			m_aliases[i] = i;
+
+			if (m_thresholds[i] < 1.0f)
+				small.push_back(i);
+			else
+				large.push_back(i);
+		}
+
+		while (!small.empty() && !large.empty())
+		{
+			const nbUint32 s = small.back();
+			small.pop_back();
+
+			const nbUint32 l = large.back();
+			large.pop_back();
+
+			m_aliases[s] = l;
+			m_thresholds[l] = (m_thresholds[l] + m_thresholds[s]) - 1.0f;
+
+			if (m_thresholds[l] < 1.0f)
+				small.push_back(l);
+			else
+				large.push_back(l);
+		}
+
+		// Remaining entries are only left by rounding errors.
+		for (nbUint32 i : small)
+			m_thresholds[i] = 1.0f;
+
+		for (nbUint32 i : large)
+			m_thresholds[i] = 1.0f;
+	}
+
+	LightPick LightSampler::pick(SampleStream& stream) const
+	{
+		NEBULA_ASSERT(!m_pdfs.empty());
+
+		const nbUint32 nbLights = (nbUint32)m_pdfs.size();
+		const nbFloat32 u = stream.generateUnsignedNormalized() * nbLights;
+
+		const nbUint32 bucket = std::min((nbUint32)u, nbLights - 1u);
+		const nbUint32 lightIdx = (u - bucket) < m_thresholds[bucket] ? bucket : m_aliases[bucket];
+
+		return { lightIdx, m_pdfs[lightIdx] };
+	}
+
+}}}}
\ No newline at end of file
@@ -0,0 +1,61 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include "LightSnapshot.h"
+#include "SampleStream.h"
+#include <vector>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+struct LightPick
+{
+	nbUint32 lightIdx;
+	nbFloat32 pdf;
+};
+
+// Picks lights proportionally to their power in constant time with an alias table.
+// Built once per render from the light snapshot, read only while rendering.
+// @See: https://www.keithschwarz.com/darts-dice-coins/
+class LightSampler
+{
+public:
+	// lights is referenced, not copied. It must outlive the sampler, usually both live for the whole render.
+	// No default constructor, a sampler always has lights to return.
+	explicit LightSampler(const LightSnapshot& lights);
+	explicit LightSampler(LightSnapshot&&) = delete;
+
+	LightPick pick(SampleStream& stream) const;
+
+	nbFloat32 getPdf(nbUint32 lightIdx) const;
+	nbUint32 getNbLights() const;
+	const LightSnapshot& getLights() const;
+
+private:
+	const LightSnapshot* m_lights;
+
+	std::vector<nbFloat32> m_pdfs;
+	std::vector<nbFloat32> m_thresholds;
+	std::vector<nbUint32> m_aliases;
+};
+
+inline nbFloat32 LightSampler::getPdf(nbUint32 lightIdx) const
+{
+	return m_pdfs[lightIdx];
+}
+
+inline nbUint32 LightSampler::getNbLights() const
+{
+	return (nbUint32)m_pdfs.size();
+}
+
+inline const LightSnapshot& LightSampler::getLights() const
+{
+	return *m_lights;
+}
+}}}}
\ No newline at end of file
@@ -0,0 +1,64 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#include "stdafx.h"
+#include "LightSnapshot.h"
+#include "Graphics/Light/DirectionnalLight.h"
+#include "Graphics/Light/OmniLight.h"
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+	LightSnapshot::LightSnapshot(const EntityIdentifierArray& lights)
+	{
+		const size_t nbLights = lights.size();
+
+		m_ownedLights.reserve(nbLights);
+		m_lights.reserve(nbLights);
+		m_types.reserve(nbLights);
+		m_colors.reserve(nbLights);
+		m_packedColors.reserve(nbLights);
+		m_positions.reserve(nbLights);
+		m_ranges.reserve(nbLights);
+		m_directions.reserve(nbLights);
+
+		for (const auto& lightId : lights)
+		{
+			const auto light = Light::getLightFromEntity(lightId);
+			NEBULA_ASSERT(light);
+
+			const auto lightType = light->getType();
+			const auto& color = light->getFinalColor();
+
+			glm::vec3 position(0.0f);
+			glm::vec3 direction(0.0f);
+			nbFloat32 range = 0.0f;
+
+			if (lightType == Light::LightType::Point)
+			{
+				const auto* omniLight = static_cast<const Light::OmniLight*>(light.get());
+				position = omniLight->getPosition();
+				range = omniLight->getRange();
+			}
+			else if (lightType == Light::LightType::Directionnal)
+			{
+				const auto* directionnalLight = static_cast<const Light::DirectionnalLight*>(light.get());
+				direction = directionnalLight->getDirection();
+			}
+
+			m_lights.push_back(light.get());
+			m_types.push_back(lightType);
+			m_colors.push_back(Spectrum(color.r, color.g, color.b));
+			m_packedColors.push_back(m_colors.back());
+			m_positions.push_back(position);
+			m_ranges.push_back(range);
+			m_directions.push_back(direction);
+
+			m_ownedLights.push_back(light);
+		}
+	}
+
+}}}}
\ No newline at end of file
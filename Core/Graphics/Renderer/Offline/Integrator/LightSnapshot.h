@@ -0,0 +1,104 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include "Spectrum.h"
+#include "Scene/BaseScene.h"
+#include "tbb/cache_aligned_allocator.h"
+#include <vector>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+// Immutable copy of the scene lights, taken once when a render starts.
+// Light properties are stored as cache aligned arrays so the integrators inner loops
+// never go through the entity database nor copy shared pointers.
+class LightSnapshot
+{
+public:
+	LightSnapshot() = default;
+	explicit LightSnapshot(const EntityIdentifierArray& lights);
+
+	nbUint32 size() const;
+	nbBool empty() const;
+
+	// Used for sampling. The snapshot keeps the light alive.
+	const Light::BaseLight& getLight(nbUint32 idx) const;
+
+	Light::LightType getType(nbUint32 idx) const;
+	const Spectrum& getColor(nbUint32 idx) const;
+
+	// Same as getColor, for the packed accumulation loops.
+	const PackedSpectrum& getPackedColor(nbUint32 idx) const;
+
+	// Point lights only.
+	const glm::vec3& getPosition(nbUint32 idx) const;
+	nbFloat32 getRange(nbUint32 idx) const;
+
+	// Directionnal lights only.
+	const glm::vec3& getDirection(nbUint32 idx) const;
+
+private:
+	template <typename T>
+	using AlignedArray = std::vector<T, tbb::cache_aligned_allocator<T>>;
+
+	std::vector<Light::DatabaseLightPtr> m_ownedLights;
+
+	AlignedArray<const Light::BaseLight*> m_lights;
+	AlignedArray<Light::LightType> m_types;
+	AlignedArray<Spectrum> m_colors;
+	AlignedArray<PackedSpectrum> m_packedColors;
+	AlignedArray<glm::vec3> m_positions;
+	AlignedArray<nbFloat32> m_ranges;
+	AlignedArray<glm::vec3> m_directions;
+};
+
+inline nbUint32 LightSnapshot::size() const
+{
+	return (nbUint32)m_lights.size();
+}
+
+inline nbBool LightSnapshot::empty() const
+{
+	return m_lights.empty();
+}
+
+inline const Light::BaseLight& LightSnapshot::getLight(nbUint32 idx) const
+{
+	return *m_lights[idx];
+}
+
+inline Light::LightType LightSnapshot::getType(nbUint32 idx) const
+{
+	return m_types[idx];
+}
+
+inline const Spectrum& LightSnapshot::getColor(nbUint32 idx) const
+{
+	return m_colors[idx];
+}
+
+inline const PackedSpectrum& LightSnapshot::getPackedColor(nbUint32 idx) const
+{
+	return m_packedColors[idx];
+}
+
+inline const glm::vec3& LightSnapshot::getPosition(nbUint32 idx) const
+{
+	return m_positions[idx];
+}
+
+inline nbFloat32 LightSnapshot::getRange(nbUint32 idx) const
+{
+	return m_ranges[idx];
+}
+
+inline const glm::vec3& LightSnapshot::getDirection(nbUint32 idx) const
+{
+	return m_directions[idx];
+}
+}}}}
\ No newline at end of file
@@ -0,0 +1,145 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#include "stdafx.h"
+#include "RayBatch.h"
+#include "tbb/tbb.h"
+#include <limits>
+#include <numeric>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+	namespace
+	{
+		constexpr nbUint32 TraceGrainSize = 256u;
+
+		// Spread the 10 low bits of value so there are two zero bits between each of them.
+		nbUint64 expandBits(nbUint32 value)
+		{
+			nbUint64 x = value & 0x3ffu;
+			x = (x | (x << 16u)) & 0x30000ffull;
+			x = (x | (x << 8u)) & 0x300f00full;
+			x = (x | (x << 4u)) & 0x30c30c3ull;
+			x = (x | (x << 2u)) & 0x9249249ull;
+			return x;
+		}
+
+		// Calls trace on each ray index of order. Batches fitting in a single grain, volume segments or probes of a few dozen rays,
+		// are traced inline on the calling thread without spawning tasks.
+		template <typename TraceFunc>
+		void traceInOrder(const std::vector<nbUint32>& order, const TraceFunc& trace)
+		{
+			const nbUint32 nbRays = (nbUint32)order.size();
+
+			if (nbRays <= TraceGrainSize)
+			{
+				for (const nbUint32 rayIdx : order)
+					trace(rayIdx);
+
+				return;
+			}
+
+			tbb::parallel_for(tbb::blocked_range<nbUint32>(0u, nbRays, TraceGrainSize), [&](const tbb::blocked_range<nbUint32>& range)
+			{
+				for (nbUint32 i = range.begin(); i != range.end(); ++i)
+					trace(order[i]);
+			});
+		}
+	}
+
+	nbUint32 RayBatch::add(const glm::vec3& origin, const glm::vec3& direction)
+	{
+		return add(origin, direction, std::numeric_limits<nbFloat32>::infinity());
+	}
+
+	nbUint32 RayBatch::add(const glm::vec3& origin, const glm::vec3& direction, nbFloat32 length)
+	{
+		m_origins.push_back(origin);
+		m_directions.push_back(direction);
+		m_lengths.push_back(length);
+
+		return (nbUint32)m_origins.size() - 1u;
+	}
+
+	Math::Ray RayBatch::getRay(nbUint32 idx) const
+	{
+		if (m_lengths[idx] == std::numeric_limits<nbFloat32>::infinity())
+			return Math::Ray(m_origins[idx], m_directions[idx]);
+
+		return Math::Ray(m_origins[idx], m_directions[idx], m_lengths[idx]);
+	}
+
+	void RayBatch::sort()
+	{
+		const nbUint32 nbRays = size();
+
+		m_order.resize(nbRays);
+		std::iota(m_order.begin(), m_order.end(), 0u);
+
+		if (nbRays < s_minSortSize)
+			return;
+
+		// Origins bounds
+		glm::vec3 minPt(std::numeric_limits<nbFloat32>::max());
+		glm::vec3 maxPt(-std::numeric_limits<nbFloat32>::max());
+
+		for (const glm::vec3& origin : m_origins)
+		{
+			minPt = glm::min(minPt, origin);
+			maxPt = glm::max(maxPt, origin);
+		}
+
+		const glm::vec3 extent = maxPt - minPt;
+		const glm::vec3 scale(extent.x > 0.0f ? 1023.0f / extent.x : 0.0f,
+			extent.y > 0.0f ? 1023.0f / extent.y : 0.0f,
+			extent.z > 0.0f ? 1023.0f / extent.z : 0.0f);
+
+		// Key = direction octant (3 bits) | origin morton code (30 bits)
+		m_keys.resize(nbRays);
+		for (nbUint32 i = 0u; i < nbRays; ++i)
+		{
+			const glm::vec3& d = m_directions[i];
+			const nbUint64 octant = (d.x < 0.0f ? 1u : 0u) | (d.y < 0.0f ? 2u : 0u) | (d.z < 0.0f ? 4u : 0u);
+
+			const glm::vec3 cell = (m_origins[i] - minPt) * scale;
+			const nbUint64 morton = expandBits((nbUint32)cell.x) | (expandBits((nbUint32)cell.y) << 1u) | (expandBits((nbUint32)cell.z) << 2u);
+
+			m_keys[i] = (octant << 30u) | morton;
+		}
+
+		tbb::parallel_sort(m_order.begin(), m_order.end(), [this](nbUint32 a, nbUint32 b)
+		{
+			return m_keys[a] != m_keys[b] ? m_keys[a] < m_keys[b] : a < b;
+		});
+	}
+
+	void RayBatch::occlusion(const Intersector::BaseIntersectorPtr& intersector, std::vector<nbFloat32>& strengths)
+	{
+		sort();
+		strengths.resize(size());
+
+		traceInOrder(m_order, [&](nbUint32 rayIdx)
+		{
+			strengths[rayIdx] = intersector->occlusion(getRay(rayIdx));
+		});
+	}
+
+	void RayBatch::intersect(const Intersector::BaseIntersectorPtr& intersector,
+		std::vector<Intersector::IntersectionInfo>& infos,
+		std::vector<nbUint8>& hits)
+	{
+		sort();
+		infos.resize(size());
+		hits.resize(size());
+
+		traceInOrder(m_order, [&](nbUint32 rayIdx)
+		{
+			hits[rayIdx] = intersector->intersect(getRay(rayIdx), infos[rayIdx]) ? 1u : 0u;
+		});
+	}
+
+}}}}
\ No newline at end of file
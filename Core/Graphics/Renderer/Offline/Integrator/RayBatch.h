@@ -0,0 +1,78 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include "../Intersector/BaseIntersector.h"
+#include <vector>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+// Set of independent rays submitted together to the intersector.
+// Before tracing, rays are reordered by direction octant then by the morton code of their origin,
+// so consecutive queries walk the same part of the acceleration structure.
+// Results are always returned in submission order.
+class RayBatch
+{
+public:
+	void clear();
+	void reserve(nbUint32 capacity);
+
+	// Returns the index of the ray in the batch results.
+	nbUint32 add(const glm::vec3& origin, const glm::vec3& direction);
+	nbUint32 add(const glm::vec3& origin, const glm::vec3& direction, nbFloat32 length);
+
+	nbUint32 size() const;
+	nbBool empty() const;
+
+	void occlusion(const Intersector::BaseIntersectorPtr& intersector, std::vector<nbFloat32>& strengths);
+
+	// hits[i] is non zero when infos[i] is valid.
+	void intersect(const Intersector::BaseIntersectorPtr& intersector,
+		std::vector<Intersector::IntersectionInfo>& infos,
+		std::vector<nbUint8>& hits);
+
+	Math::Ray getRay(nbUint32 idx) const;
+
+	// Batches smaller than this are traced in submission order.
+	static constexpr nbUint32 s_minSortSize = 64u;
+
+private:
+	void sort();
+
+	std::vector<glm::vec3> m_origins;
+	std::vector<glm::vec3> m_directions;
+	std::vector<nbFloat32> m_lengths;
+
+	std::vector<nbUint64> m_keys;
+	std::vector<nbUint32> m_order;
+};
+
+inline void RayBatch::clear()
+{
+	m_origins.clear();
+	m_directions.clear();
+	m_lengths.clear();
+}
+
+inline void RayBatch::reserve(nbUint32 capacity)
+{
+	m_origins.reserve(capacity);
+	m_directions.reserve(capacity);
+	m_lengths.reserve(capacity);
+}
+
+inline nbUint32 RayBatch::size() const
+{
+	return (nbUint32)m_origins.size();
+}
+
+inline nbBool RayBatch::empty() const
+{
+	return m_origins.empty();
+}
+}}}}
\ No newline at end of file
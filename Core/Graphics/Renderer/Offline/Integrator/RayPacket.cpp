@@ -0,0 +1,40 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#include "stdafx.h"
+#include "RayPacket.h"
+#include <limits>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+	void occlusion(const Intersector::BaseIntersectorPtr& intersector, const RayPacket& packet, nbFloat32 (&strengths)[RayPacket::MaxSize])
+	{
+		NEBULA_ASSERT(packet.size <= RayPacket::MaxSize);
+
+		for (nbUint32 i = 0u; i < packet.size; ++i)
+		{
+			const Math::Ray ray(packet.origin, packet.directions[i]);
+			strengths[i] = intersector->occlusion(ray);
+		}
+	}
+
+	void intersectDistance(const Intersector::BaseIntersectorPtr& intersector, const RayPacket& packet, nbFloat32 (&distances)[RayPacket::MaxSize])
+	{
+		NEBULA_ASSERT(packet.size <= RayPacket::MaxSize);
+
+		for (nbUint32 i = 0u; i < packet.size; ++i)
+		{
+			const Math::Ray ray(packet.origin, packet.directions[i]);
+
+			Intersector::IntersectionInfo info;
+			distances[i] = intersector->intersect(ray, info) ?
+				info.meshIntersectData.packetIntersectionResult.t :
+				std::numeric_limits<nbFloat32>::infinity();
+		}
+	}
+
+}}}}
\ No newline at end of file
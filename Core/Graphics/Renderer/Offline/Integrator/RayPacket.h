@@ -0,0 +1,31 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include "../Intersector/BaseIntersector.h"
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+// Rays sharing the same origin, submitted together.
+// The intersector only has single ray queries, so the rays of a packet are traced one by one, back to back,
+// which keeps the traversal data of the shared origin hot in cache. There is no SIMD packet traversal.
+struct RayPacket
+{
+	static constexpr nbUint32 MaxSize = NEBULA_INTRINSICS_NB_FLOAT;
+
+	glm::vec3 origin;
+	glm::vec3 directions[MaxSize];
+	nbUint32 size = 0u;
+};
+
+// Occlusion strength of each ray of the packet.
+void occlusion(const Intersector::BaseIntersectorPtr& intersector, const RayPacket& packet, nbFloat32 (&strengths)[RayPacket::MaxSize]);
+
+// Closest hit distance of each ray of the packet. Infinity if the ray does not hit anything.
+void intersectDistance(const Intersector::BaseIntersectorPtr& intersector, const RayPacket& packet, nbFloat32 (&distances)[RayPacket::MaxSize]);
+}}}}
\ No newline at end of file
@@ -0,0 +1,88 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include "BasicTypes.h"
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+// Counter based random number stream.
+// Each value is a pure hash of (pixel index, sample index, dimension) so there is no shared state
+// between render threads and a render is reproducible whatever the thread count or tile order.
+// @See: http://www.jcgt.org/published/0009/03/02/
+class SampleStream
+{
+public:
+	SampleStream(nbUint32 pixelIdx, nbUint32 sampleIdx, nbUint32 dimension = 0u);
+
+	// Value in [0, 1)
+	nbFloat32 generateUnsignedNormalized();
+
+	// Value in [-1, 1)
+	nbFloat32 generateSignedNormalized();
+
+	// Value in [min, max)
+	nbFloat32 generateBeetween(nbFloat32 min, nbFloat32 max);
+
+	nbUint32 generateUint32();
+
+	nbUint32 getDimension() const;
+	void setDimension(nbUint32 dimension);
+
+private:
+	static nbUint32 pcgHash(nbUint32 value);
+
+	nbUint32 m_key;
+	nbUint32 m_dimension;
+};
+
+inline SampleStream::SampleStream(nbUint32 pixelIdx, nbUint32 sampleIdx, nbUint32 dimension)
+: m_key(pcgHash(pixelIdx + pcgHash(sampleIdx)))
+, m_dimension(dimension)
+{
+}
+
+inline nbUint32 SampleStream::pcgHash(nbUint32 value)
+{
+	const nbUint32 state = value * 747796405u + 2891336453u;
+	const nbUint32 word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+inline nbUint32 SampleStream::generateUint32()
+{
+	// Weyl sequence on the dimension keeps consecutive dimensions decorrelated.
+	return pcgHash(m_key ^ (m_dimension++ * 0x9E3779B9u));
+}
+
+inline nbFloat32 SampleStream::generateUnsignedNormalized()
+{
+	// Keep the 24 high bits so the result is exactly representable and strictly lower than 1.
+	return (nbFloat32)(generateUint32() >> 8u) * (1.0f / 16777216.0f);
+}
+
+inline nbFloat32 SampleStream::generateSignedNormalized()
+{
+	return generateUnsignedNormalized() * 2.0f - 1.0f;
+}
+
+inline nbFloat32 SampleStream::generateBeetween(nbFloat32 min, nbFloat32 max)
+{
+	return min + (max - min) * generateUnsignedNormalized();
+}
+
+inline nbUint32 SampleStream::getDimension() const
+{
+	return m_dimension;
+}
+
+inline void SampleStream::setDimension(nbUint32 dimension)
+{
+	m_dimension = dimension;
+}
+}}}}
\ No newline at end of file
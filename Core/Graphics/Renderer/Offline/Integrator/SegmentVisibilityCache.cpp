@@ -0,0 +1,89 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#include "stdafx.h"
+#include "SegmentVisibilityCache.h"
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+	const nbFloat32 SegmentVisibilityCache::s_tolerance = 0.05f;
+
+	SegmentVisibilityCache::SegmentVisibilityCache(const Intersector::BaseIntersectorPtr& intersector,
+		const LightSnapshot& lights,
+		const glm::vec3& startPt,
+		const glm::vec3& step,
+		nbUint32 nbSteps,
+		nbUint32 stride,
+		SampleStream& stream)
+	: m_intersector(intersector)
+	, m_lights(lights)
+	, m_stream(stream)
+	, m_startPt(startPt)
+	, m_step(step)
+	, m_nbSteps(nbSteps)
+	, m_occlusions(lights.size() * nbSteps, 0.0f)
+	{
+		if (!nbSteps)
+			return;
+
+		stride = std::max(1u, stride);
+		const nbUint32 lastStep = nbSteps - 1u;
+
+		for (nbUint32 lightIdx = 0u; lightIdx < lights.size(); ++lightIdx)
+		{
+			trace(lightIdx, 0u);
+
+			for (nbUint32 first = 0u; first < lastStep; first += stride)
+			{
+				const nbUint32 last = std::min(first + stride, lastStep);
+				trace(lightIdx, last);
+				refine(lightIdx, first, last);
+			}
+		}
+	}
+
+	void SegmentVisibilityCache::refine(nbUint32 lightIdx, nbUint32 first, nbUint32 last)
+	{
+		if (last - first < 2u)
+			return;
+
+		nbFloat32* occlusions = &m_occlusions[lightIdx * m_nbSteps];
+
+		if (std::abs(occlusions[first] - occlusions[last]) <= s_tolerance)
+		{
+			const nbFloat32 delta = (occlusions[last] - occlusions[first]) / (last - first);
+			for (nbUint32 i = first + 1u; i < last; ++i)
+				occlusions[i] = occlusions[first] + delta * (i - first);
+
+			return;
+		}
+
+		const nbUint32 middle = (first + last) / 2u;
+		trace(lightIdx, middle);
+
+		refine(lightIdx, first, middle);
+		refine(lightIdx, middle, last);
+	}
+
+	void SegmentVisibilityCache::trace(nbUint32 lightIdx, nbUint32 stepIdx)
+	{
+		const glm::vec3 point = m_startPt + m_step * (nbFloat32)stepIdx;
+		nbFloat32& occlusion = m_occlusions[lightIdx * m_nbSteps + stepIdx];
+
+		const auto sampleToLight = m_lights.getLight(lightIdx).generateSampleToLight(m_stream, point);
+		if (!sampleToLight.canProcess)
+		{
+			occlusion = 1.0f;
+			return;
+		}
+
+		const Math::Ray sRay(point, sampleToLight.L, sampleToLight.length);
+		occlusion = m_intersector->occlusion(sRay);
+		++m_nbShadowRays;
+	}
+
+}}}}
@@ -0,0 +1,66 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include "LightSnapshot.h"
+#include "SampleStream.h"
+#include "../Intersector/BaseIntersector.h"
+#include <vector>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+// Light occlusion at the regular steps of a ray marched segment.
+// Occlusion is traced every stride steps. In between, it is interpolated when both ends agree,
+// otherwise the interval is bisected until they do or the steps are adjacent.
+// Occluders thinner than the stride which do not change the ends of an interval are missed.
+class SegmentVisibilityCache
+{
+public:
+	SegmentVisibilityCache(const Intersector::BaseIntersectorPtr& intersector,
+		const LightSnapshot& lights,
+		const glm::vec3& startPt,
+		const glm::vec3& step,
+		nbUint32 nbSteps,
+		nbUint32 stride,
+		SampleStream& stream);
+
+	nbFloat32 getOcclusion(nbUint32 lightIdx, nbUint32 stepIdx) const;
+
+	nbUint32 getNbShadowRays() const;
+
+private:
+	void refine(nbUint32 lightIdx, nbUint32 first, nbUint32 last);
+	void trace(nbUint32 lightIdx, nbUint32 stepIdx);
+
+	const Intersector::BaseIntersectorPtr& m_intersector;
+	const LightSnapshot& m_lights;
+	SampleStream& m_stream;
+
+	glm::vec3 m_startPt;
+	glm::vec3 m_step;
+	nbUint32 m_nbSteps;
+
+	// Indexed by lightIdx * m_nbSteps + stepIdx.
+	std::vector<nbFloat32> m_occlusions;
+	nbUint32 m_nbShadowRays = 0u;
+
+	// Ends closer than this are interpolated.
+	static const nbFloat32 s_tolerance;
+};
+
+inline nbFloat32 SegmentVisibilityCache::getOcclusion(nbUint32 lightIdx, nbUint32 stepIdx) const
+{
+	NEBULA_ASSERT(stepIdx < m_nbSteps);
+	return m_occlusions[lightIdx * m_nbSteps + stepIdx];
+}
+
+inline nbUint32 SegmentVisibilityCache::getNbShadowRays() const
+{
+	return m_nbShadowRays;
+}
+}}}}
@@ -0,0 +1,169 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#include "stdafx.h"
+#include "ShadingVertexCache.h"
+#include <algorithm>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+	void buildShadingTriangle(const IntersectedMeshPtr& mesh, nbUint32 triStartIdx, ShadingTriangle& dst)
+	{
+		for (nbUint32 i = 0u; i < NEBULA_PRIMITIVE_NB_VTX; ++i)
+		{
+			const auto vertex = mesh->buildTransformedVertexFromIndices(triStartIdx + i);
+
+			dst.positions[i] = vertex.position;
+			dst.normals[i] = vertex.normal;
+			dst.tangents[i] = vertex.tangent;
+			dst.bitangents[i] = vertex.bitangent;
+			dst.texCoords[i] = vertex.texCoord;
+		}
+	}
+
+	ShadingVertexCache::Chunk::Chunk()
+	{
+		for (nbUint32 i = 0u; i < ChunkSize; ++i)
+			states[i].store(Empty, std::memory_order_relaxed);
+	}
+
+	ShadingVertexCache::MeshEntry::MeshEntry(const IntersectedMeshPtr& mesh, nbUint32 nbChunks)
+	: mesh(mesh)
+	, nbChunks(nbChunks)
+	, chunks(new std::atomic<Chunk*>[nbChunks])
+	{
+		computeTransformKey(mesh, transformKey);
+
+		for (nbUint32 i = 0u; i < nbChunks; ++i)
+			chunks[i].store(nullptr, std::memory_order_relaxed);
+	}
+
+	ShadingVertexCache::MeshEntry::~MeshEntry()
+	{
+		for (nbUint32 i = 0u; i < nbChunks; ++i)
+			delete chunks[i].load(std::memory_order_relaxed);
+	}
+
+	void ShadingVertexCache::computeTransformKey(const IntersectedMeshPtr& mesh, glm::vec3 (&dst)[NEBULA_PRIMITIVE_NB_VTX + 1u])
+	{
+		ShadingTriangle triangle;
+		buildShadingTriangle(mesh, 0u, triangle);
+
+		for (nbUint32 i = 0u; i < NEBULA_PRIMITIVE_NB_VTX; ++i)
+			dst[i] = triangle.positions[i];
+
+		dst[NEBULA_PRIMITIVE_NB_VTX] = triangle.normals[0];
+	}
+
+	void ShadingVertexCache::validate()
+	{
+		std::vector<const void*> movedKeys;
+
+		for (const auto& entry : m_entries)
+		{
+			glm::vec3 transformKey[NEBULA_PRIMITIVE_NB_VTX + 1u];
+			computeTransformKey(entry.second->mesh, transformKey);
+
+			if (!std::equal(std::begin(transformKey), std::end(transformKey), std::begin(entry.second->transformKey)))
+				movedKeys.push_back(entry.first);
+		}
+
+		for (const void* key : movedKeys)
+			erase(key);
+	}
+
+	void ShadingVertexCache::invalidate(const IntersectedMeshPtr& mesh)
+	{
+		erase(&*mesh);
+	}
+
+	void ShadingVertexCache::erase(const void* key)
+	{
+		auto entryIt = m_entries.find(key);
+		if (entryIt == m_entries.end())
+			return;
+
+		m_nbBytes -= (nbUint64)entryIt->second->nbAllocatedChunks * sizeof(Chunk);
+		m_entries.unsafe_erase(entryIt);
+	}
+
+	ShadingVertexCache::MeshEntry& ShadingVertexCache::getOrCreateEntry(const IntersectedMeshPtr& mesh)
+	{
+		const void* key = &*mesh;
+
+		auto entryIt = m_entries.find(key);
+		if (entryIt != m_entries.end())
+			return *entryIt->second;
+
+		// Triangle packets may be partially filled, their slots are allocated anyway.
+		const nbUint32 nbTriangles = (nbUint32)mesh->getTrianglePackets().size() * NEBULA_INTRINSICS_NB_FLOAT;
+
+		// An entry is only an array of chunk pointers and the transform key. Threads racing on the first hit of a mesh
+		// each allocate one and all but the inserted one free it, only the key triangle was transformed.
+		return *m_entries.insert(std::make_pair(key, std::make_unique<MeshEntry>(mesh, (nbTriangles + ChunkSize - 1u) / ChunkSize))).first->second;
+	}
+
+	ShadingVertexCache::Chunk& ShadingVertexCache::getOrCreateChunk(MeshEntry& entry, nbUint32 chunkIdx)
+	{
+		Chunk* chunk = entry.chunks[chunkIdx].load(std::memory_order_acquire);
+		if (chunk)
+			return *chunk;
+
+		// Same for chunks, the allocation is the only work lost by the threads losing the race.
+		std::unique_ptr<Chunk> newChunk = std::make_unique<Chunk>();
+		if (entry.chunks[chunkIdx].compare_exchange_strong(chunk, newChunk.get(), std::memory_order_acq_rel))
+		{
+			++entry.nbAllocatedChunks;
+			m_nbBytes += sizeof(Chunk);
+			return *newChunk.release();
+		}
+
+		return *chunk;
+	}
+
+	void ShadingVertexCache::fetch(const IntersectedMeshPtr& mesh, nbUint32 triStartIdx, ShadingTriangle& dst)
+	{
+		const nbUint32 triIdx = triStartIdx / NEBULA_PRIMITIVE_NB_VTX;
+
+		Chunk& chunk = getOrCreateChunk(getOrCreateEntry(mesh), triIdx / ChunkSize);
+		std::atomic<nbUint8>& state = chunk.states[triIdx % ChunkSize];
+		const nbUint32 vtxStartIdx = (triIdx % ChunkSize) * NEBULA_PRIMITIVE_NB_VTX;
+
+		if (state.load(std::memory_order_acquire) != Ready)
+		{
+			buildShadingTriangle(mesh, triStartIdx, dst);
+
+			// Only one thread publishes the triangle. The others keep their local copy.
+			nbUint8 expected = Empty;
+			if (state.compare_exchange_strong(expected, Building, std::memory_order_acquire))
+			{
+				for (nbUint32 i = 0u; i < NEBULA_PRIMITIVE_NB_VTX; ++i)
+				{
+					chunk.positions[vtxStartIdx + i] = dst.positions[i];
+					chunk.normals[vtxStartIdx + i] = dst.normals[i];
+					chunk.tangents[vtxStartIdx + i] = dst.tangents[i];
+					chunk.bitangents[vtxStartIdx + i] = dst.bitangents[i];
+					chunk.texCoords[vtxStartIdx + i] = dst.texCoords[i];
+				}
+
+				state.store(Ready, std::memory_order_release);
+			}
+
+			return;
+		}
+
+		for (nbUint32 i = 0u; i < NEBULA_PRIMITIVE_NB_VTX; ++i)
+		{
+			dst.positions[i] = chunk.positions[vtxStartIdx + i];
+			dst.normals[i] = chunk.normals[vtxStartIdx + i];
+			dst.tangents[i] = chunk.tangents[vtxStartIdx + i];
+			dst.bitangents[i] = chunk.bitangents[vtxStartIdx + i];
+			dst.texCoords[i] = chunk.texCoords[vtxStartIdx + i];
+		}
+	}
+
+}}}}
\ No newline at end of file
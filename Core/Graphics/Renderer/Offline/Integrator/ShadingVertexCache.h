@@ -0,0 +1,118 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include "../Intersector/IntersectionInfo.h"
+#include "tbb/concurrent_unordered_map.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+using IntersectedMeshPtr = decltype(Intersector::IntersectionInfo::object);
+
+// World space attributes of the three vertices of a triangle.
+struct ShadingTriangle
+{
+	glm::vec3 positions[NEBULA_PRIMITIVE_NB_VTX];
+	glm::vec3 normals[NEBULA_PRIMITIVE_NB_VTX];
+	glm::vec3 tangents[NEBULA_PRIMITIVE_NB_VTX];
+	glm::vec3 bitangents[NEBULA_PRIMITIVE_NB_VTX];
+	glm::vec2 texCoords[NEBULA_PRIMITIVE_NB_VTX];
+};
+
+// Transform the triangle vertices. This is what the cache saves on every hit.
+void buildShadingTriangle(const IntersectedMeshPtr& mesh, nbUint32 triStartIdx, ShadingTriangle& dst);
+
+// Pre-transformed world space vertex attributes, stored per mesh as flat arrays indexed like the triangle packets.
+// Triangles are transformed lazily the first time they are hit, then shading is a plain gather.
+// Storage is allocated by chunks of ChunkSize triangles on their first hit, about 170 bytes per triangle of a hit chunk,
+// so a mesh seen through a few pixels does not get a full world space copy.
+// The cache is optional: buildIntersectionProperties transforms the vertices on every hit when it gets none,
+// which is the switch to compare the memory cost reported by getNbBytes against the shading time.
+//
+// Entries are keyed on the mesh and keep the world space first triangle of the mesh when created. validate compares it
+// to the current one, so meshes moved by an edit are transformed again and the others keep their vertices.
+class ShadingVertexCache
+{
+public:
+	static constexpr nbUint32 ChunkSize = 256u;
+
+	void fetch(const IntersectedMeshPtr& mesh, nbUint32 triStartIdx, ShadingTriangle& dst);
+
+	// Drops the entries of the meshes whose transform changed since they were cached.
+	// Not thread safe, never call it while rendering. WavefrontIntegrator calls it before each integration.
+	void validate();
+
+	// Same, without checking the transforms. Not thread safe either.
+	void invalidate();
+	void invalidate(const IntersectedMeshPtr& mesh);
+
+	// Bytes of the allocated chunks.
+	nbUint64 getNbBytes() const;
+
+private:
+	enum TriangleState : nbUint8
+	{
+		Empty,
+		Building,
+		Ready
+	};
+
+	struct Chunk
+	{
+		Chunk();
+
+		std::atomic<nbUint8> states[ChunkSize];
+
+		glm::vec3 positions[ChunkSize * NEBULA_PRIMITIVE_NB_VTX];
+		glm::vec3 normals[ChunkSize * NEBULA_PRIMITIVE_NB_VTX];
+		glm::vec3 tangents[ChunkSize * NEBULA_PRIMITIVE_NB_VTX];
+		glm::vec3 bitangents[ChunkSize * NEBULA_PRIMITIVE_NB_VTX];
+		glm::vec2 texCoords[ChunkSize * NEBULA_PRIMITIVE_NB_VTX];
+	};
+
+	struct MeshEntry
+	{
+		MeshEntry(const IntersectedMeshPtr& mesh, nbUint32 nbChunks);
+		~MeshEntry();
+
+		// Also keeps the mesh alive, so its address is not reused by another mesh while cached.
+		IntersectedMeshPtr mesh;
+
+		// World space positions of the first triangle and normal of its first vertex.
+		// Three points only fix an affine transform up to a mirror through their plane, the normal tells it apart.
+		glm::vec3 transformKey[NEBULA_PRIMITIVE_NB_VTX + 1u];
+
+		nbUint32 nbChunks;
+		std::unique_ptr<std::atomic<Chunk*>[]> chunks;
+		std::atomic<nbUint32> nbAllocatedChunks{0u};
+	};
+
+	static void computeTransformKey(const IntersectedMeshPtr& mesh, glm::vec3 (&dst)[NEBULA_PRIMITIVE_NB_VTX + 1u]);
+
+	MeshEntry& getOrCreateEntry(const IntersectedMeshPtr& mesh);
+	void erase(const void* key);
+	Chunk& getOrCreateChunk(MeshEntry& entry, nbUint32 chunkIdx);
+
+	tbb::concurrent_unordered_map<const void*, std::unique_ptr<MeshEntry>> m_entries;
+	std::atomic<nbUint64> m_nbBytes{0u};
+};
+
+inline void ShadingVertexCache::invalidate()
+{
+	m_entries.clear();
+	m_nbBytes = 0u;
+}
+
+inline nbUint64 ShadingVertexCache::getNbBytes() const
+{
+	return m_nbBytes.load(std::memory_order_relaxed);
+}
+}}}}
\ No newline at end of file
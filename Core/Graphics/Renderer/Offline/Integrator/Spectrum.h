@@ -7,11 +7,246 @@
 
 #pragma once
 
+#include "FastMath.h"
 #include "Graphics/Color.h"
+#include <xmmintrin.h>
 
 namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
 {
 using Spectrum = RGBColor;
 const Spectrum BlackRGBSpectrum = Spectrum(0.0f);
 const Spectrum WhiteRGBSpectrum = Spectrum(1.0f);
-}}}}
\ No newline at end of file
+
+// Rec. 709 luminance weights, shared by all the spectrum types.
+const nbFloat32 LuminanceR = 0.2126f;
+const nbFloat32 LuminanceG = 0.7152f;
+const nbFloat32 LuminanceB = 0.0722f;
+
+inline nbFloat32 getLuminance(const Spectrum& s)
+{
+	return LuminanceR * s.x + LuminanceG * s.y + LuminanceB * s.z;
+}
+
+// Spectrum held in a SSE register, used by the accumulation loops of the integrators.
+// The fourth lane is padding and always stays at zero.
+class alignas(16) PackedSpectrum
+{
+public:
+	PackedSpectrum();
+	explicit PackedSpectrum(__m128 v);
+	explicit PackedSpectrum(nbFloat32 v);
+	PackedSpectrum(const Spectrum& s);
+
+	Spectrum toSpectrum() const;
+	__m128 get() const;
+
+	PackedSpectrum& operator+=(const PackedSpectrum& s);
+	PackedSpectrum& operator-=(const PackedSpectrum& s);
+	PackedSpectrum& operator*=(const PackedSpectrum& s);
+	PackedSpectrum& operator*=(nbFloat32 f);
+	PackedSpectrum& operator/=(nbFloat32 f);
+
+private:
+	__m128 m_v;
+};
+
+inline PackedSpectrum::PackedSpectrum()
+: m_v(_mm_setzero_ps())
+{
+}
+
+inline PackedSpectrum::PackedSpectrum(__m128 v)
+: m_v(v)
+{
+}
+
+inline PackedSpectrum::PackedSpectrum(nbFloat32 v)
+: m_v(_mm_set_ps(0.0f, v, v, v))
+{
+}
+
+inline PackedSpectrum::PackedSpectrum(const Spectrum& s)
+: m_v(_mm_set_ps(0.0f, s.z, s.y, s.x))
+{
+}
+
+inline Spectrum PackedSpectrum::toSpectrum() const
+{
+	alignas(16) nbFloat32 lanes[4];
+	_mm_store_ps(lanes, m_v);
+
+	return Spectrum(lanes[0], lanes[1], lanes[2]);
+}
+
+inline __m128 PackedSpectrum::get() const
+{
+	return m_v;
+}
+
+inline PackedSpectrum& PackedSpectrum::operator+=(const PackedSpectrum& s)
+{
+	m_v = _mm_add_ps(m_v, s.m_v);
+	return *this;
+}
+
+inline PackedSpectrum& PackedSpectrum::operator-=(const PackedSpectrum& s)
+{
+	m_v = _mm_sub_ps(m_v, s.m_v);
+	return *this;
+}
+
+inline PackedSpectrum& PackedSpectrum::operator*=(const PackedSpectrum& s)
+{
+	m_v = _mm_mul_ps(m_v, s.m_v);
+	return *this;
+}
+
+inline PackedSpectrum& PackedSpectrum::operator*=(nbFloat32 f)
+{
+	m_v = _mm_mul_ps(m_v, _mm_set1_ps(f));
+	return *this;
+}
+
+inline PackedSpectrum& PackedSpectrum::operator/=(nbFloat32 f)
+{
+	m_v = _mm_mul_ps(m_v, _mm_set1_ps(1.0f / f));
+	return *this;
+}
+
+inline PackedSpectrum operator+(PackedSpectrum a, const PackedSpectrum& b)
+{
+	return a += b;
+}
+
+inline PackedSpectrum operator-(PackedSpectrum a, const PackedSpectrum& b)
+{
+	return a -= b;
+}
+
+inline PackedSpectrum operator*(PackedSpectrum a, const PackedSpectrum& b)
+{
+	return a *= b;
+}
+
+inline PackedSpectrum operator*(PackedSpectrum a, nbFloat32 f)
+{
+	return a *= f;
+}
+
+inline PackedSpectrum operator*(nbFloat32 f, PackedSpectrum a)
+{
+	return a *= f;
+}
+
+inline PackedSpectrum operator/(PackedSpectrum a, nbFloat32 f)
+{
+	return a /= f;
+}
+
+inline nbBool isNegligeable(const PackedSpectrum& s)
+{
+	static const nbFloat32 oeps = 1e-5f;
+	return (_mm_movemask_ps(_mm_cmplt_ps(s.get(), _mm_set1_ps(oeps))) & 0x7) == 0x7;
+}
+
+inline nbFloat32 getLuminance(const PackedSpectrum& s)
+{
+	const __m128 weighted = _mm_mul_ps(s.get(), _mm_set_ps(0.0f, LuminanceB, LuminanceG, LuminanceR));
+
+	// Horizontal sum, the padding lane is zero.
+	const __m128 shuffled = _mm_shuffle_ps(weighted, weighted, _MM_SHUFFLE(2, 3, 0, 1));
+	const __m128 sums = _mm_add_ps(weighted, shuffled);
+	return _mm_cvtss_f32(_mm_add_ss(sums, _mm_movehl_ps(shuffled, sums)));
+}
+
+// exp2(-extinction * distance) per channel. Follows NEBULA_FAST_MATH_POLICY.
+inline PackedSpectrum computeTransmittance(const PackedSpectrum& extinction, nbFloat32 distance)
+{
+	// The padding lane becomes one, keep it at zero.
+	const __m128 transmittance = fastExp2(_mm_mul_ps(extinction.get(), _mm_set1_ps(-distance)));
+	return PackedSpectrum(_mm_and_ps(transmittance, _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1))));
+}
+
+// Structure of arrays of spectrums, one per ray of a packet. Lane loops have a constant trip count and vectorize.
+struct alignas(32) SpectrumN
+{
+	static constexpr nbUint32 Size = NEBULA_INTRINSICS_NB_FLOAT;
+
+	nbFloat32 r[Size];
+	nbFloat32 g[Size];
+	nbFloat32 b[Size];
+
+	void setZero();
+	void set(nbUint32 lane, const Spectrum& s);
+	Spectrum get(nbUint32 lane) const;
+
+	// Multiply each lane by its weight.
+	void scale(const nbFloat32 (&weights)[Size]);
+
+	// Sum of all the lanes.
+	Spectrum sum() const;
+
+	void getLuminances(nbFloat32 (&dst)[Size]) const;
+
+	// Bit i is set when lane i is negligeable.
+	nbUint32 getNegligeableMask() const;
+};
+
+inline void SpectrumN::setZero()
+{
+	for (nbUint32 i = 0u; i < Size; ++i)
+		r[i] = g[i] = b[i] = 0.0f;
+}
+
+inline void SpectrumN::set(nbUint32 lane, const Spectrum& s)
+{
+	r[lane] = s.x;
+	g[lane] = s.y;
+	b[lane] = s.z;
+}
+
+inline Spectrum SpectrumN::get(nbUint32 lane) const
+{
+	return Spectrum(r[lane], g[lane], b[lane]);
+}
+
+inline void SpectrumN::scale(const nbFloat32 (&weights)[Size])
+{
+	for (nbUint32 i = 0u; i < Size; ++i)
+	{
+		r[i] *= weights[i];
+		g[i] *= weights[i];
+		b[i] *= weights[i];
+	}
+}
+
+inline Spectrum SpectrumN::sum() const
+{
+	nbFloat32 sumR = 0.0f, sumG = 0.0f, sumB = 0.0f;
+	for (nbUint32 i = 0u; i < Size; ++i)
+	{
+		sumR += r[i];
+		sumG += g[i];
+		sumB += b[i];
+	}
+
+	return Spectrum(sumR, sumG, sumB);
+}
+
+inline void SpectrumN::getLuminances(nbFloat32 (&dst)[Size]) const
+{
+	for (nbUint32 i = 0u; i < Size; ++i)
+		dst[i] = LuminanceR * r[i] + LuminanceG * g[i] + LuminanceB * b[i];
+}
+
+inline nbUint32 SpectrumN::getNegligeableMask() const
+{
+	static const nbFloat32 oeps = 1e-5f;
+
+	nbUint32 mask = 0u;
+	for (nbUint32 i = 0u; i < Size; ++i)
+		mask |= (nbUint32)((r[i] < oeps) & (g[i] < oeps) & (b[i] < oeps)) << i;
+
+	return mask;
+}
+}}}}
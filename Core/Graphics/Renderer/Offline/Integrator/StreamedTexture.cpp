@@ -0,0 +1,212 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#include "stdafx.h"
+#include "StreamedTexture.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+	const nbUint32 StreamedTexture::s_magic = 0x5854424Eu; // "NBTX"
+
+	// Increment when the layout changes, older files are then converted again.
+	const nbUint32 StreamedTexture::s_version = 2u;
+
+	StreamedTexture::StreamedTexture(TextureTileCache& tileCache)
+	: m_tileCache(tileCache)
+	, m_textureId(tileCache.registerTexture())
+	, m_tilesOffset(0u)
+	{
+	}
+
+	nbBool StreamedTexture::write(const BaseTexture& source, nbUint64 sourceKey, const std::string& path)
+	{
+		const std::string tmpPath = path + ".tmp";
+		std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			NEBULA_TRACE("StreamedTexture::write - Unable to create the texture file");
+			return false;
+		}
+
+		// Zero initialized so the padding bytes written are deterministic.
+		FileHeader header = {};
+		header.magic = s_magic;
+		header.version = s_version;
+		header.sourceKey = sourceKey;
+		header.width = source.getWidth();
+		header.height = source.getHeight();
+		header.nbLevels = source.getNbLevels();
+
+		std::vector<FileLevel> levels(header.nbLevels);
+		nbUint32 nbTiles = 0u;
+
+		for (nbUint32 l = 0u; l < header.nbLevels; ++l)
+		{
+			FileLevel& level = levels[l];
+			level.width = std::max(1u, header.width >> l);
+			level.height = std::max(1u, header.height >> l);
+			level.nbTilesX = (level.width + TextureTile::Size - 1u) >> TextureTile::SizeLog2;
+			level.firstTileIdx = nbTiles;
+
+			nbTiles += level.nbTilesX * ((level.height + TextureTile::Size - 1u) >> TextureTile::SizeLog2);
+		}
+
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)levels.data(), levels.size() * sizeof(FileLevel));
+
+		TextureTile tile;
+
+		for (nbUint32 l = 0u; l < header.nbLevels; ++l)
+		{
+			const FileLevel& level = levels[l];
+			const nbUint32 nbTilesY = (level.height + TextureTile::Size - 1u) >> TextureTile::SizeLog2;
+
+			for (nbUint32 tileY = 0u; tileY < nbTilesY; ++tileY)
+			{
+				for (nbUint32 tileX = 0u; tileX < level.nbTilesX; ++tileX)
+				{
+					for (nbUint32 y = 0u; y < TextureTile::Size; ++y)
+					{
+						for (nbUint32 x = 0u; x < TextureTile::Size; ++x)
+						{
+							// Padding texels repeat the level edges.
+							const nbUint32 levelX = std::min((tileX << TextureTile::SizeLog2) + x, level.width - 1u);
+							const nbUint32 levelY = std::min((tileY << TextureTile::SizeLog2) + y, level.height - 1u);
+
+							const glm::vec2 ratio((levelX + 0.5f) / level.width, (levelY + 0.5f) / level.height);
+							tile.texels[spreadBits(x) | (spreadBits(y) << 1u)] = packTexel(source.getNormalizedPixelFromRatio(ratio, (nbFloat32)l));
+						}
+					}
+
+					file.write((const char*)&tile, sizeof(tile));
+				}
+			}
+		}
+
+		file.close();
+
+		if (!file)
+		{
+			NEBULA_TRACE("StreamedTexture::write - Unable to write the texture file");
+			return false;
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tmpPath, path, error);
+
+		return !error;
+	}
+
+	std::unique_ptr<StreamedTexture> StreamedTexture::open(const std::string& path, nbUint64 sourceKey, TextureTileCache& tileCache)
+	{
+		std::unique_ptr<StreamedTexture> texture(new StreamedTexture(tileCache));
+		if (!texture->m_file.open(path))
+			return nullptr;
+
+		const nbUint8* data = texture->m_file.getData();
+		const nbUint64 size = texture->m_file.getSize();
+
+		FileHeader header;
+		if (size < sizeof(header))
+		{
+			NEBULA_TRACE("StreamedTexture::open - Truncated texture file");
+			return nullptr;
+		}
+
+		std::memcpy(&header, data, sizeof(header));
+
+		if (header.magic != s_magic || header.version != s_version || !header.nbLevels)
+		{
+			NEBULA_TRACE("StreamedTexture::open - Invalid texture file");
+			return nullptr;
+		}
+
+		// Not an error, the image changed since the conversion.
+		if (header.sourceKey != sourceKey)
+			return nullptr;
+
+		texture->m_tilesOffset = sizeof(FileHeader) + (nbUint64)header.nbLevels * sizeof(FileLevel);
+		if (size < texture->m_tilesOffset)
+		{
+			NEBULA_TRACE("StreamedTexture::open - Truncated texture file");
+			return nullptr;
+		}
+
+		texture->m_levels.resize(header.nbLevels);
+		std::memcpy(texture->m_levels.data(), data + sizeof(FileHeader), header.nbLevels * sizeof(FileLevel));
+
+		// Levels must follow each other, so every tile fetch reads inside the file.
+		nbUint64 nbTiles = 0u;
+		for (const FileLevel& level : texture->m_levels)
+		{
+			if (!level.width || !level.height || level.firstTileIdx != nbTiles ||
+				level.nbTilesX != (level.width + TextureTile::Size - 1u) >> TextureTile::SizeLog2)
+			{
+				NEBULA_TRACE("StreamedTexture::open - Invalid texture file");
+				return nullptr;
+			}
+
+			nbTiles += (nbUint64)level.nbTilesX * ((level.height + TextureTile::Size - 1u) >> TextureTile::SizeLog2);
+		}
+
+		if (size < texture->m_tilesOffset + nbTiles * sizeof(TextureTile))
+		{
+			NEBULA_TRACE("StreamedTexture::open - Truncated texture file");
+			return nullptr;
+		}
+
+		return texture;
+	}
+
+	nbBool StreamedTexture::loadTile(nbUint32 tileIdx, TextureTile& dst) const
+	{
+		// In bounds, checked by open.
+		std::memcpy(&dst, m_file.getData() + m_tilesOffset + (nbUint64)tileIdx * sizeof(TextureTile), sizeof(TextureTile));
+		return true;
+	}
+
+	glm::vec4 StreamedTexture::fetch(nbUint32 levelIdx, const glm::vec2& ratio) const
+	{
+		const FileLevel& level = m_levels[levelIdx];
+
+		const nbUint32 x = std::min((nbUint32)std::max(ratio.x * level.width, 0.0f), level.width - 1u);
+		const nbUint32 y = std::min((nbUint32)std::max(ratio.y * level.height, 0.0f), level.height - 1u);
+
+		const nbUint32 tileIdx = level.firstTileIdx + (y >> TextureTile::SizeLog2) * level.nbTilesX + (x >> TextureTile::SizeLog2);
+
+		const TextureTilePtr tile = m_tileCache.get(m_textureId, levelIdx, tileIdx, [&](TextureTile& dst)
+		{
+			return loadTile(tileIdx, dst);
+		});
+
+		if (!tile)
+			return glm::vec4(0.0f);
+
+		static const nbUint32 mask = TextureTile::Size - 1u;
+		return unpackTexel(tile->texels[spreadBits(x & mask) | (spreadBits(y & mask) << 1u)]);
+	}
+
+	glm::vec4 StreamedTexture::getNormalizedPixelFromRatio(const glm::vec2& ratio, nbFloat32 lod) const
+	{
+		// Also catches NaN.
+		if (!(lod > 0.0f))
+			return fetch(0u, ratio);
+
+		const nbUint32 lastLevel = (nbUint32)m_levels.size() - 1u;
+		if (lod >= (nbFloat32)lastLevel)
+			return fetch(lastLevel, ratio);
+
+		const nbUint32 level = (nbUint32)lod;
+		const nbFloat32 blend = lod - (nbFloat32)level;
+
+		return fetch(level, ratio) * (1.0f - blend) + fetch(level + 1u, ratio) * blend;
+	}
+
+}}}}
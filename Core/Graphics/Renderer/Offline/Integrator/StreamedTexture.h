@@ -0,0 +1,92 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include "BaseTexture.h"
+#include "TextureTileCache.h"
+#include "Graphics/Renderer/Cache/MappedFile.h"
+#include <string>
+#include <vector>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+// Texture read from a tiled file through a TextureTileCache. Only the tiles in the cache are resident.
+// The file is memory mapped, tile misses copy from the mapping without locking so they proceed in parallel.
+//
+// File layout, little endian:
+//	FileHeader
+//	FileLevel[nbLevels]
+//	TextureTile[nbTiles], the tiles of each level row by row, levels from the largest.
+class StreamedTexture : public BaseTexture
+{
+public:
+	// Writes every level of source, including its MIP pyramid.
+	// sourceKey identifies the image source was converted from, see open.
+	// The file is written next to path then renamed, so readers never see a partial file.
+	static nbBool write(const BaseTexture& source, nbUint64 sourceKey, const std::string& path);
+
+	// Nullptr if the file is missing, truncated, from another format version or from another source image.
+	static std::unique_ptr<StreamedTexture> open(const std::string& path, nbUint64 sourceKey, TextureTileCache& tileCache);
+
+	glm::vec4 getNormalizedPixelFromRatio(const glm::vec2& ratio, nbFloat32 lod) const override;
+
+	nbUint32 getWidth() const override;
+	nbUint32 getHeight() const override;
+	nbUint32 getNbLevels() const override;
+
+private:
+	static const nbUint32 s_magic;
+	static const nbUint32 s_version;
+
+	struct FileHeader
+	{
+		nbUint32 magic;
+		nbUint32 version;
+		nbUint64 sourceKey;
+		nbUint32 width;
+		nbUint32 height;
+		nbUint32 nbLevels;
+	};
+
+	struct FileLevel
+	{
+		nbUint32 width;
+		nbUint32 height;
+		nbUint32 nbTilesX;
+		nbUint32 firstTileIdx;
+	};
+
+	StreamedTexture(TextureTileCache& tileCache);
+
+	glm::vec4 fetch(nbUint32 levelIdx, const glm::vec2& ratio) const;
+	nbBool loadTile(nbUint32 tileIdx, TextureTile& dst) const;
+
+	TextureTileCache& m_tileCache;
+	nbUint32 m_textureId;
+
+	std::vector<FileLevel> m_levels;
+	nbUint64 m_tilesOffset;
+
+	Cache::MappedFile m_file;
+};
+
+inline nbUint32 StreamedTexture::getWidth() const
+{
+	return m_levels[0].width;
+}
+
+inline nbUint32 StreamedTexture::getHeight() const
+{
+	return m_levels[0].height;
+}
+
+inline nbUint32 StreamedTexture::getNbLevels() const
+{
+	return (nbUint32)m_levels.size();
+}
+}}}}
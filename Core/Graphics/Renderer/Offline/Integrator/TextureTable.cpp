@@ -0,0 +1,183 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#include "stdafx.h"
+#include "StreamedTexture.h"
+#include "TextureTable.h"
+#include "Graphics/Material/FresnelMaterial.h"
+#include <chrono>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+	namespace
+	{
+		nbUint32 getIndexHash(nbUint64 key)
+		{
+			return (nbUint32)((key * 0x9e3779b97f4a7c15ull) >> 32);
+		}
+
+		// Changes with the image, the source assets and the image revision of the table. Cheap, the image is not loaded.
+		nbUint64 computeFileKey(const EntityIdentifier& imageId, nbUint64 sourceKey, nbUint64 imageRevision)
+		{
+			nbUint64 key = sourceKey;
+			for (const nbUint64 word : { (nbUint64)imageId.getValue(), imageRevision })
+				key = (((key << 31) | (key >> 33)) ^ word) * 0x9e3779b97f4a7c15ull;
+
+			return key;
+		}
+	}
+
+	void TiledTexture::addLevel(nbUint32 width, nbUint32 height)
+	{
+		Level level;
+		level.width = width;
+		level.height = height;
+		level.nbTilesX = (width + TileSize - 1u) >> TileSizeLog2;
+		level.offset = (nbUint32)m_texels.size();
+
+		// Levels are padded to whole tiles.
+		const nbUint32 nbTilesY = (height + TileSize - 1u) >> TileSizeLog2;
+		m_texels.resize(m_texels.size() + level.nbTilesX * nbTilesY * TileSize * TileSize, 0u);
+
+		m_levels.push_back(level);
+	}
+
+	void TiledTexture::store(const Level& level, nbUint32 x, nbUint32 y, const glm::vec4& color)
+	{
+		m_texels[getTexelIdx(level, x, y)] = packTexel(color);
+	}
+
+	TextureTable::TextureTable(TextureTileCache* tileCache, const std::string& cacheDirectory, nbUint64 sourceKey)
+	: m_tileCache(tileCache)
+	, m_cacheDirectory(cacheDirectory)
+	, m_sourceKey(sourceKey)
+	{
+	}
+
+	void TextureTable::invalidateImages()
+	{
+		invalidate();
+		m_imageRevision = std::max<nbUint64>(m_imageRevision + 1u, (nbUint64)std::chrono::system_clock::now().time_since_epoch().count());
+	}
+
+	void TextureTable::prepare(const Model::ModelPtr& model)
+	{
+		NEBULA_ASSERT(m_slotIndex.empty());
+
+		const auto& materials = model->getMaterials();
+		const nbUint32 nbSlots = (nbUint32)materials.size();
+		if (!nbSlots)
+			return;
+
+		nbUint32 indexSize = 1u;
+		while (indexSize < 2u * nbSlots)
+			indexSize <<= 1u;
+
+		m_slotIndex.assign(indexSize, SlotIndexEntry{ 0u, InvalidSlot });
+		m_slots = std::make_unique<MaterialSlot[]>(nbSlots);
+
+		nbUint32 slotIdx = 0u;
+		for (const auto& materialId : materials)
+		{
+			const nbUint64 key = (nbUint64)materialId.getValue();
+			if (findSlot(key) != InvalidSlot)
+				continue;
+
+			nbUint32 entryIdx = getIndexHash(key) & (indexSize - 1u);
+			while (m_slotIndex[entryIdx].slotIdx != InvalidSlot)
+				entryIdx = (entryIdx + 1u) & (indexSize - 1u);
+
+			m_slotIndex[entryIdx] = { key, slotIdx++ };
+		}
+	}
+
+	nbUint32 TextureTable::findSlot(nbUint64 materialKey) const
+	{
+		if (m_slotIndex.empty())
+			return InvalidSlot;
+
+		const nbUint32 mask = (nbUint32)m_slotIndex.size() - 1u;
+		for (nbUint32 entryIdx = getIndexHash(materialKey) & mask;; entryIdx = (entryIdx + 1u) & mask)
+		{
+			const SlotIndexEntry& entry = m_slotIndex[entryIdx];
+			if (entry.slotIdx == InvalidSlot || entry.materialKey == materialKey)
+				return entry.slotIdx;
+		}
+	}
+
+	const BaseTexture* TextureTable::getNormalMap(const Model::ModelPtr& model, const EntityIdentifier& materialId)
+	{
+		const nbUint64 key = (nbUint64)materialId.getValue();
+
+		const nbUint32 slotIdx = findSlot(key);
+		if (slotIdx == InvalidSlot)
+			return m_unpreparedNormalMaps.getOrBuild(key, [&]() { return resolveNormalMap(model, materialId); });
+
+		MaterialSlot& slot = m_slots[slotIdx];
+		tbb::collaborative_call_once(slot.flag, [&]()
+		{
+			slot.normalMap = resolveNormalMap(model, materialId);
+		});
+
+		return slot.normalMap;
+	}
+
+	const BaseTexture* TextureTable::resolveNormalMap(const Model::ModelPtr& model, const EntityIdentifier& materialId)
+	{
+		const Material::DatabaseMaterialPtr material = model->getMaterialFromEntityOrDefault(materialId);
+		if (!material->isFresnelMaterial())
+			return nullptr;
+
+		const auto* fresnelMat = static_cast<const Material::FresnelMaterial*>(material.get());
+		const EntityIdentifier normalMapId = fresnelMat->getNormalImageId();
+
+		return normalMapId ? getOrCreateTexture(normalMapId) : nullptr;
+	}
+
+	const BaseTexture* TextureTable::getOrCreateTexture(const EntityIdentifier& imageId)
+	{
+		// Materials sharing an image share its texture.
+		return m_textures.getOrBuild((nbUint64)imageId.getValue(), [&]() { return createTexture(imageId); }).get();
+	}
+
+	std::unique_ptr<BaseTexture> TextureTable::createTexture(const EntityIdentifier& imageId)
+	{
+		if (m_tileCache)
+		{
+			if (auto texture = createStreamedTexture(imageId))
+				return texture;
+		}
+
+		const auto image = Texture::getRGBAImageFromEntity(imageId);
+		if (!image)
+			return nullptr;
+
+		return std::make_unique<TiledTexture>(image);
+	}
+
+	std::unique_ptr<BaseTexture> TextureTable::createStreamedTexture(const EntityIdentifier& imageId)
+	{
+		// Textures of an image are built once, no other thread of this table writes the file meanwhile.
+		const std::string path = m_cacheDirectory + "/" + std::to_string(imageId.getValue()) + ".nbtex";
+
+		const nbUint64 fileKey = computeFileKey(imageId, m_sourceKey, m_imageRevision);
+
+		// The image is only loaded to convert it, when the file is missing or stale.
+		if (auto texture = StreamedTexture::open(path, fileKey, *m_tileCache))
+			return std::move(texture);
+
+		const auto image = Texture::getRGBAImageFromEntity(imageId);
+		if (!image)
+			return nullptr;
+
+		if (!StreamedTexture::write(TiledTexture(image), fileKey, path))
+			return nullptr;
+
+		return StreamedTexture::open(path, fileKey, *m_tileCache);
+	}
+
+}}}}
@@ -0,0 +1,238 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include "BaseTexture.h"
+#include "BuildOnceMap.h"
+#include "Scene/BaseScene.h"
+#include "tbb/cache_aligned_allocator.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+// RGBA8 copy of an image stored by square tiles, with the texels of a tile in morton order.
+// Texels close in both directions share cache lines, which a row major image only does horizontally.
+// A box filtered MIP pyramid is built with the copy, so distant hits read a small level.
+class TiledTexture : public BaseTexture
+{
+public:
+	template <typename ImagePtr>
+	explicit TiledTexture(const ImagePtr& image);
+
+	// Nearest texel of the base level, like Image::getNormalizedPixelFromRatio.
+	glm::vec4 getNormalizedPixelFromRatio(const glm::vec2& ratio) const;
+
+	glm::vec4 getNormalizedPixelFromRatio(const glm::vec2& ratio, nbFloat32 lod) const override;
+
+	nbUint32 getWidth() const override;
+	nbUint32 getHeight() const override;
+	nbUint32 getNbLevels() const override;
+
+private:
+	static const nbUint32 TileSizeLog2 = 5u;
+	static const nbUint32 TileSize = 1u << TileSizeLog2;
+
+	struct Level
+	{
+		nbUint32 width;
+		nbUint32 height;
+		nbUint32 nbTilesX;
+
+		// First texel of the level in m_texels.
+		nbUint32 offset;
+	};
+
+	void addLevel(nbUint32 width, nbUint32 height);
+	nbUint32 getTexelIdx(const Level& level, nbUint32 x, nbUint32 y) const;
+	glm::vec4 fetch(const Level& level, const glm::vec2& ratio) const;
+	void store(const Level& level, nbUint32 x, nbUint32 y, const glm::vec4& color);
+
+	std::vector<Level> m_levels;
+	std::vector<nbUint32, tbb::cache_aligned_allocator<nbUint32>> m_texels;
+};
+
+template <typename ImagePtr>
+TiledTexture::TiledTexture(const ImagePtr& image)
+{
+	addLevel(std::max(1u, (nbUint32)image->getWidth()), std::max(1u, (nbUint32)image->getHeight()));
+
+	const Level& base = m_levels[0];
+	for (nbUint32 y = 0u; y < base.height; ++y)
+	{
+		for (nbUint32 x = 0u; x < base.width; ++x)
+		{
+			// Texel centers read back the source texels exactly.
+			const glm::vec2 ratio((x + 0.5f) / base.width, (y + 0.5f) / base.height);
+			store(base, x, y, glm::vec4(image->getNormalizedPixelFromRatio(ratio)));
+		}
+	}
+
+	// Each level averages 2x2 texels of the previous one, the last row and column are reused for odd sizes.
+	while (m_levels.back().width > 1u || m_levels.back().height > 1u)
+	{
+		const nbUint32 parentIdx = (nbUint32)m_levels.size() - 1u;
+		addLevel(std::max(1u, m_levels[parentIdx].width / 2u), std::max(1u, m_levels[parentIdx].height / 2u));
+
+		const Level& parent = m_levels[parentIdx];
+		const Level& level = m_levels.back();
+
+		for (nbUint32 y = 0u; y < level.height; ++y)
+		{
+			for (nbUint32 x = 0u; x < level.width; ++x)
+			{
+				const nbUint32 x0 = std::min(2u * x, parent.width - 1u);
+				const nbUint32 x1 = std::min(2u * x + 1u, parent.width - 1u);
+				const nbUint32 y0 = std::min(2u * y, parent.height - 1u);
+				const nbUint32 y1 = std::min(2u * y + 1u, parent.height - 1u);
+
+				const glm::vec2 invSize(1.0f / parent.width, 1.0f / parent.height);
+				auto parentTexel = [&](nbUint32 px, nbUint32 py)
+				{
+					return fetch(parent, glm::vec2(px + 0.5f, py + 0.5f) * invSize);
+				};
+
+				store(level, x, y, (parentTexel(x0, y0) + parentTexel(x1, y0) + parentTexel(x0, y1) + parentTexel(x1, y1)) * 0.25f);
+			}
+		}
+	}
+}
+
+inline nbUint32 TiledTexture::getTexelIdx(const Level& level, nbUint32 x, nbUint32 y) const
+{
+	const nbUint32 tileIdx = (y >> TileSizeLog2) * level.nbTilesX + (x >> TileSizeLog2);
+	const nbUint32 inTileIdx = spreadBits(x & (TileSize - 1u)) | (spreadBits(y & (TileSize - 1u)) << 1u);
+
+	return level.offset + ((tileIdx << (2u * TileSizeLog2)) | inTileIdx);
+}
+
+inline glm::vec4 TiledTexture::fetch(const Level& level, const glm::vec2& ratio) const
+{
+	const nbUint32 x = std::min((nbUint32)std::max(ratio.x * level.width, 0.0f), level.width - 1u);
+	const nbUint32 y = std::min((nbUint32)std::max(ratio.y * level.height, 0.0f), level.height - 1u);
+
+	return unpackTexel(m_texels[getTexelIdx(level, x, y)]);
+}
+
+inline glm::vec4 TiledTexture::getNormalizedPixelFromRatio(const glm::vec2& ratio) const
+{
+	return fetch(m_levels[0], ratio);
+}
+
+inline glm::vec4 TiledTexture::getNormalizedPixelFromRatio(const glm::vec2& ratio, nbFloat32 lod) const
+{
+	// Also catches NaN.
+	if (!(lod > 0.0f))
+		return fetch(m_levels[0], ratio);
+
+	const nbUint32 lastLevel = (nbUint32)m_levels.size() - 1u;
+	if (lod >= (nbFloat32)lastLevel)
+		return fetch(m_levels[lastLevel], ratio);
+
+	const nbUint32 level = (nbUint32)lod;
+	const nbFloat32 blend = lod - (nbFloat32)level;
+
+	return fetch(m_levels[level], ratio) * (1.0f - blend) + fetch(m_levels[level + 1u], ratio) * blend;
+}
+
+inline nbUint32 TiledTexture::getWidth() const
+{
+	return m_levels[0].width;
+}
+
+inline nbUint32 TiledTexture::getHeight() const
+{
+	return m_levels[0].height;
+}
+
+inline nbUint32 TiledTexture::getNbLevels() const
+{
+	return (nbUint32)m_levels.size();
+}
+
+class TextureTileCache;
+
+// Textures used while shading, resolved once per material for the lifetime of a render.
+// The first hit of a material goes through the entity database and converts its normal map to a TiledTexture.
+// Later hits only read the table. Shared between the render threads.
+//
+// prepare gives each material of the model a slot found through a flat read only index, so hits
+// neither hash into a concurrent map nor touch the entity database. Other materials use a slower concurrent map.
+// A texture is built by a single thread, the other threads needing it wait, because a conversion copies the
+// whole image and its MIP pyramid.
+//
+// With a tile cache, textures are streamed instead. Each image is converted once to <cacheDirectory>/<imageId>.nbtex.
+// The file stores a key of the image id, the source assets and the image revision, and is opened without loading
+// the image while they match. It is converted again otherwise.
+class TextureTable
+{
+public:
+	TextureTable() = default;
+	// sourceKey identifies the assets the images come from, e.g. the SceneCache::computeSourceKey of the scene file.
+	TextureTable(TextureTileCache* tileCache, const std::string& cacheDirectory, nbUint64 sourceKey);
+
+	// Assigns the slots of the model materials. Call it before rendering, after invalidate. Not thread safe.
+	void prepare(const Model::ModelPtr& model);
+
+	// Nullptr if the material has no normal map.
+	const BaseTexture* getNormalMap(const Model::ModelPtr& model, const EntityIdentifier& materialId);
+
+	// Must be called when a material changes. Not thread safe, never call it while rendering.
+	// Converted files are kept and reused.
+	void invalidate();
+
+	// Same, when an image changes. Converted files cannot tell, they are all converted again.
+	void invalidateImages();
+
+private:
+	struct MaterialSlot
+	{
+		tbb::collaborative_once_flag flag;
+		const BaseTexture* normalMap = nullptr;
+	};
+
+	// Open addressing, m_slotIndex size is a power of two at least twice the number of slots.
+	struct SlotIndexEntry
+	{
+		nbUint64 materialKey;
+		nbUint32 slotIdx;
+	};
+
+	static const nbUint32 InvalidSlot = ~0u;
+
+	nbUint32 findSlot(nbUint64 materialKey) const;
+
+	const BaseTexture* resolveNormalMap(const Model::ModelPtr& model, const EntityIdentifier& materialId);
+	const BaseTexture* getOrCreateTexture(const EntityIdentifier& imageId);
+	std::unique_ptr<BaseTexture> createTexture(const EntityIdentifier& imageId);
+	std::unique_ptr<BaseTexture> createStreamedTexture(const EntityIdentifier& imageId);
+
+	TextureTileCache* m_tileCache = nullptr;
+	std::string m_cacheDirectory;
+	nbUint64 m_sourceKey = 0u;
+
+	// 0 while the images are those of the source assets, then the time of the last image change,
+	// so files of edits from another session never match.
+	nbUint64 m_imageRevision = 0u;
+
+	std::vector<SlotIndexEntry> m_slotIndex;
+	std::unique_ptr<MaterialSlot[]> m_slots;
+
+	BuildOnceMap<nbUint64, const BaseTexture*> m_unpreparedNormalMaps;
+	BuildOnceMap<nbUint64, std::unique_ptr<BaseTexture>> m_textures;
+};
+
+inline void TextureTable::invalidate()
+{
+	m_slotIndex.clear();
+	m_slots.reset();
+	m_unpreparedNormalMaps.clear();
+	m_textures.clear();
+}
+}}}}
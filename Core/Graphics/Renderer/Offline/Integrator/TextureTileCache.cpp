@@ -0,0 +1,76 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#include "stdafx.h"
+#include "TextureTileCache.h"
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+	TextureTileCache::TextureTileCache(nbUint64 maxBytes)
+	: m_maxTilesPerShard(std::max(1u, (nbUint32)std::min<nbUint64>(maxBytes / sizeof(TextureTile) / NbShards, UINT32_MAX)))
+	, m_nbTextures(0u)
+	, m_nbLoads(0u)
+	, m_nbEvictions(0u)
+	{
+	}
+
+	nbUint32 TextureTileCache::registerTexture()
+	{
+		return m_nbTextures.fetch_add(1u);
+	}
+
+	TextureTileCache::Shard& TextureTileCache::getShard(nbUint64 key)
+	{
+		// Fibonacci hashing, neighbouring tiles land in different shards.
+		return m_shards[(key * 0x9E3779B97F4A7C15ull) >> 60u];
+	}
+
+	TextureTilePtr TextureTileCache::get(nbUint32 textureId, nbUint32 level, nbUint32 tileIdx, const LoadTileFunc& loadTile)
+	{
+		NEBULA_ASSERT(level < 64u && tileIdx < (1u << 26u));
+
+		const nbUint64 key = ((nbUint64)textureId << 32u) | ((nbUint64)level << 26u) | tileIdx;
+		Shard& shard = getShard(key);
+
+		{
+			std::lock_guard<std::mutex> lock(shard.mutex);
+
+			auto entryIt = shard.entries.find(key);
+			if (entryIt != shard.entries.end())
+			{
+				shard.lru.splice(shard.lru.begin(), shard.lru, entryIt->second);
+				return entryIt->second->second;
+			}
+		}
+
+		// Load without holding the lock. Two threads missing the same tile both load it, one copy is kept.
+		auto tile = std::make_shared<TextureTile>();
+		if (!loadTile(*tile))
+			return nullptr;
+
+		m_nbLoads.fetch_add(1u);
+
+		std::lock_guard<std::mutex> lock(shard.mutex);
+
+		auto entryIt = shard.entries.find(key);
+		if (entryIt != shard.entries.end())
+			return entryIt->second->second;
+
+		shard.lru.emplace_front(key, tile);
+		shard.entries.emplace(key, shard.lru.begin());
+
+		while (shard.lru.size() > m_maxTilesPerShard)
+		{
+			shard.entries.erase(shard.lru.back().first);
+			shard.lru.pop_back();
+			m_nbEvictions.fetch_add(1u);
+		}
+
+		return tile;
+	}
+
+}}}}
@@ -0,0 +1,83 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+// Square block of RGBA8 texels in morton order. This is also the unit of the streamed texture files.
+struct TextureTile
+{
+	static const nbUint32 SizeLog2 = 6u;
+	static const nbUint32 Size = 1u << SizeLog2;
+
+	nbUint32 texels[Size * Size];
+};
+
+using TextureTilePtr = std::shared_ptr<const TextureTile>;
+
+// Bounded set of texture tiles shared by all the streamed textures and all the render threads.
+// The least recently used tiles are dropped once the budget is reached. Tiles are reference counted
+// so a tile evicted while a thread reads it stays valid until that thread releases it.
+// Entries are split in shards with their own lock to limit contention.
+class TextureTileCache
+{
+public:
+	using LoadTileFunc = std::function<nbBool(TextureTile& dst)>;
+
+	explicit TextureTileCache(nbUint64 maxBytes);
+
+	// Identifier of a new texture, part of the tiles keys.
+	nbUint32 registerTexture();
+
+	// Loads the tile on a miss. Nullptr if loading fails.
+	TextureTilePtr get(nbUint32 textureId, nbUint32 level, nbUint32 tileIdx, const LoadTileFunc& loadTile);
+
+	nbUint64 getNbLoads() const;
+	nbUint64 getNbEvictions() const;
+
+private:
+	static const nbUint32 NbShards = 16u;
+
+	struct Shard
+	{
+		using Entry = std::pair<nbUint64, TextureTilePtr>;
+
+		std::mutex mutex;
+
+		// Most recently used first.
+		std::list<Entry> lru;
+		std::unordered_map<nbUint64, std::list<Entry>::iterator> entries;
+	};
+
+	Shard& getShard(nbUint64 key);
+
+	Shard m_shards[NbShards];
+	nbUint32 m_maxTilesPerShard;
+
+	std::atomic<nbUint32> m_nbTextures;
+	std::atomic<nbUint64> m_nbLoads;
+	std::atomic<nbUint64> m_nbEvictions;
+};
+
+inline nbUint64 TextureTileCache::getNbLoads() const
+{
+	return m_nbLoads.load();
+}
+
+inline nbUint64 TextureTileCache::getNbEvictions() const
+{
+	return m_nbEvictions.load();
+}
+}}}}
@@ -9,127 +9,475 @@
 
 #include "Math/Generator/RandomPrimitiveSampleGenerator.h"
 #include "DirectLightningIntegrator.h"
+#include "FastMath.h"
+#include "RayBatch.h"
+#include "SegmentVisibilityCache.h"
 #include "VolumeIntegrator.h"
 
 namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
 {
+	namespace
+	{
+		// Shorter segments neither attenuate nor scatter. Their direction is undefined, and the equiangular pdf divides by their angle.
+		const nbFloat32 MinSegmentLength = 1e-6f;
+
+		struct IndirectRayBuffers
+		{
+			RayBatch rays;
+			std::vector<nbFloat32> weights;
+			std::vector<RayCone> cones;
+			std::vector<Intersector::IntersectionInfo> isectResults;
+			std::vector<nbUint8> hits;
+			std::vector<nbFloat32> hitTransmittances;
+		};
+
+		// Indirect ray buffers reused by the segments and probes a thread traces, so they are not allocated every time.
+		// Each thread keeps a pool rather than a single set: probes are built while the buffers of their segment are in use,
+		// and a thread waiting on a parallel batch may pick up another segment.
+		class IndirectRayBuffersLease
+		{
+		public:
+			IndirectRayBuffersLease()
+			{
+				if (s_pool.empty())
+				{
+					m_buffers = std::make_unique<IndirectRayBuffers>();
+				}
+				else
+				{
+					m_buffers = std::move(s_pool.back());
+					s_pool.pop_back();
+				}
+
+				m_buffers->rays.clear();
+				m_buffers->weights.clear();
+				m_buffers->cones.clear();
+			}
+
+			~IndirectRayBuffersLease()
+			{
+				s_pool.push_back(std::move(m_buffers));
+			}
+
+			IndirectRayBuffers* operator->() const
+			{
+				return m_buffers.get();
+			}
+
+		private:
+			static thread_local std::vector<std::unique_ptr<IndirectRayBuffers>> s_pool;
+			std::unique_ptr<IndirectRayBuffers> m_buffers;
+		};
+
+		thread_local std::vector<std::unique_ptr<IndirectRayBuffers>> IndirectRayBuffersLease::s_pool;
+	}
+
+	const nbUint32 VolumeIntegrator::s_maxNbSamples = 1024u;
+
 	// @See: https://cs.dartmouth.edu/~wjarosz/publications/dissertation/chapter4.pdf
 	Spectrum VolumeIntegrator::sample(const Intersector::BaseIntersectorPtr& intersector,
 		const Scene::BaseScene* scene,
+		const LightSnapshot& lights,
 		const Spectrum& inRadiance,
 		const glm::vec3& startPt,
 		const glm::vec3& endPt,
-		const MediaPtr& media)
+		const MediaPtr& media,
+		SampleStream& stream,
+		const VolumeSamplingSettings& samplingSettings,
+		const RayCone& rayCone)
 	{
 		const MediaSettings& mediaSettings = media->getMediaSettings();
 
 		const glm::vec3 direction = endPt - startPt;
 		const nbFloat32 dirLength = glm::length(direction);
+		const nbFloat32 extinction = media->getExtinctionCoeff();
 
-		nbUint32 nbSamples = mediaSettings.m_nbSamples;
+		// E.g. a hit at the ray origin.
+		if (dirLength <= MinSegmentLength)
+			return inRadiance;
+
+		nbFloat32 requestedNbSamples = (nbFloat32)mediaSettings.m_nbSamples;
 		if (mediaSettings.m_dynamicNbSamples)
 		{
 			// Compute dynamic nb samples based on line size.
 			const nbFloat32 boundsSize = glm::length(scene->getModel()->getBounds().getSize());
 			const nbFloat32 lengthOverBoundsSize = dirLength / boundsSize;
 
-			nbSamples = (nbUint32)(nbSamples * lengthOverBoundsSize);
+			requestedNbSamples *= lengthOverBoundsSize;
 		}
 
+		// The requested count may be zero or huge, for example along a ray leaving the scene.
+		VolumeSampleBudget* budget = samplingSettings.m_budget;
+		nbUint32 nbSamples = budget ? budget->acquire(requestedNbSamples) :
+			(requestedNbSamples >= 1.0f ? (nbUint32)std::min(requestedNbSamples, (nbFloat32)s_maxNbSamples) : 1u);
 
-		Spectrum accInRadiance;
+		PackedSpectrum accInRadiance;
 		{
 			// Accumulated in-scattering radiance
-			const glm::vec3 step = direction / (nbFloat32)nbSamples;
-
-			//const nbFloat32 stepSize = dirLength / nbSamples;
-			//const nbFloat32 segmentTransmittance = std::exp2f(-stepSize * extinction);
-			//const nbFloat32 scatteringTransmitance = segmentTransmittance * mediaSettings.m_scatteringCoeff;
+			// Indirect rays of the whole segment are traced together once the direct light is done.
+			const IndirectRayBuffersLease buffers;
+			RayBatch& indirectRays = buffers->rays;
+			std::vector<nbFloat32>& indirectWeights = buffers->weights;
+			std::vector<RayCone>& indirectCones = buffers->cones;
 
-			glm::vec3 indirectSamples[2];
-			glm::vec3 currentPt = startPt;
+			VolumeIrradianceCache* irradianceCache = samplingSettings.m_irradianceCache;
+			const VolumeIrradianceCache::BuildProbeFunc buildProbe = [&](const glm::vec3& position, nbUint32 nbRays, SampleStream& probeStream, IrradianceProbe& dst)
+			{
+				buildIrradianceProbe(intersector, scene, lights, extinction, position, nbRays, samplingSettings, probeStream, dst);
+			};
 
-			for (nbUint32 i = 0u; i < nbSamples; ++i, currentPt += step)
+			auto addIndirectSamples = [&](const glm::vec3& point, nbFloat32 weight)
 			{
-				Spectrum directRadiance;
+				// Compute two samples. One randomly chosen and its opposite.
+				const nbFloat32 r1 = stream.generateSignedNormalized();
+				const nbFloat32 r2 = stream.generateUnsignedNormalized();
+
+				const glm::vec3 indirectSample = Math::uniformSphericalSample(r1, r2);
+
+				if (irradianceCache)
 				{
-					// Compute direct contribution from lights
-					for (const auto& lightId : scene->getLights())
-					{
-						const auto light = Light::getLightFromEntity(lightId);
-						const auto sampleToLight = light->generateSampleToLight(s_nbGenerator, currentPt);
-						if (!sampleToLight.canProcess)
-							continue;
+					// The probe holds the mean of the two samples. Its sky part is weighted by a phase sample.
+					const IrradianceProbe probe = irradianceCache->lookup(point, extinction, buildProbe);
+					const nbFloat32 phase = media->sample(direction, indirectSample);
+
+					accInRadiance += (2.0f * weight) * (probe.surfaceRadiance + phase * probe.skyRadiance);
+					return;
+				}
+
+				indirectRays.add(point, indirectSample);
+				indirectRays.add(point, -indirectSample);
+
+				indirectWeights.push_back(weight);
+				indirectWeights.push_back(weight);
 
-						const Math::Ray sRay(currentPt, sampleToLight.L, sampleToLight.length);
-						const nbFloat32 occlusionStrength = intersector->occlusion(sRay);
+				// Scattering does not focus the footprint, both rays leave with the cone widened up to the point.
+				const RayCone indirectCone = rayCone.propagate(glm::length(point - startPt));
+				indirectCones.push_back(indirectCone);
+				indirectCones.push_back(indirectCone);
+			};
 
-						if (occlusionStrength != 1.0f)
+			if (mediaSettings.m_multipleStattering && !irradianceCache)
+			{
+				indirectRays.reserve(2u * nbSamples);
+				indirectWeights.reserve(2u * nbSamples);
+				indirectCones.reserve(2u * nbSamples);
+			}
+
+			if (samplingSettings.m_mode == VolumeSamplingMode::RayMarching)
+			{
+				const glm::vec3 step = direction / (nbFloat32)nbSamples;
+
+				//const nbFloat32 stepSize = dirLength / nbSamples;
+				//const nbFloat32 segmentTransmittance = std::exp2f(-stepSize * extinction);
+				//const nbFloat32 scatteringTransmitance = segmentTransmittance * mediaSettings.m_scatteringCoeff;
+
+				std::unique_ptr<SegmentVisibilityCache> visibilityCache;
+				if (samplingSettings.m_visibilityStride > 1u)
+					visibilityCache = std::make_unique<SegmentVisibilityCache>(intersector, lights, startPt, step, nbSamples, samplingSettings.m_visibilityStride, stream);
+
+				// Welford accumulation of the direct light luminance of the steps.
+				nbUint32 nbSteps = 0u;
+				nbFloat32 luminanceMean = 0.0f;
+				nbFloat32 luminanceM2 = 0.0f;
+
+				auto march = [&](const glm::vec3& firstPt, const glm::vec3& marchStep, nbUint32 count, nbBool useCache)
+				{
+					glm::vec3 currentPt = firstPt;
+
+					for (nbUint32 i = 0u; i < count; ++i, currentPt += marchStep)
+					{
+						// Compute direct contribution from lights
+						PackedSpectrum directRadiance;
+						for (nbUint32 lightIdx = 0u; lightIdx < lights.size(); ++lightIdx)
 						{
-							const nbFloat32 phase = media->sample(direction, sampleToLight.L);
-							const nbFloat32 distanceFactor = light->getType() != Light::Point ? 1.0f :
-								std::exp2f(-sampleToLight.length * media->getExtinctionCoeff());
-
-							directRadiance += phase *
-								distanceFactor *
-								light->getFinalColor() *
-								(1.0f - occlusionStrength);
+							directRadiance += useCache ?
+								sampleInScattering(lights, lightIdx, currentPt, direction, media, visibilityCache->getOcclusion(lightIdx, i), stream) :
+								sampleInScattering(intersector, lights, lightIdx, currentPt, direction, media, stream);
 						}
+
+						accInRadiance += directRadiance;
+
+						const nbFloat32 luminance = getLuminance(directRadiance);
+						const nbFloat32 delta = luminance - luminanceMean;
+						luminanceMean += delta / (nbFloat32)++nbSteps;
+						luminanceM2 += delta * (luminance - luminanceMean);
+
+						if (mediaSettings.m_multipleStattering)
+							addIndirectSamples(currentPt, 1.0f);
 					}
-				}
+				};
 
-				Spectrum indirectRadiance;
-				if (mediaSettings.m_multipleStattering)
-				{
-					// Compute indirect contributions.
-					// Compute two samples. One randomly chosen and its opposite.
-					const nbFloat32 r1 = s_nbGenerator.generateSignedNormalized();
-					const nbFloat32 r2 = s_nbGenerator.generateUnsignedNormalized();
+				march(startPt, step, nbSamples, visibilityCache != nullptr);
 
-					indirectSamples[0] = Math::uniformSphericalSample(r1, r2);
-					indirectSamples[1] = -indirectSamples[0];
+				if (budget)
+				{
+					// Refine noisy segments by marching the middle of the current steps.
+					const nbFloat32 noiseThreshold = budget->getSettings().m_noiseThreshold;
+					glm::vec3 refinedStep = step;
 
-					for (const glm::vec3& sample : indirectSamples)
+					while (nbSteps > 1u)
 					{
-						const Math::Ray ray(currentPt, sample);
+						const nbFloat32 standardError = std::sqrt(luminanceM2 / (nbFloat32)((nbSteps - 1u) * nbSteps));
+						if (standardError <= noiseThreshold * std::max(luminanceMean, 1e-3f))
+							break;
 
-						Intersector::IntersectionInfo isectResult;
-						if (intersector->intersect(ray, isectResult))
-						{
-							const auto isectProps = buildIntersectionProperties(ray, isectResult, scene);
-							const auto material = scene->getModel()->getMaterialFromEntityOrDefault(isectResult.object->getMaterialId());
+						const nbUint32 nbExtraSteps = budget->acquireRefinement(nbSteps);
+						if (!nbExtraSteps)
+							break;
+
+						march(startPt + refinedStep * 0.5f, refinedStep, nbExtraSteps, false);
+						refinedStep *= 0.5f;
+					}
+
+					nbSamples = nbSteps;
+				}
+			}
+			else
+			{
+				const glm::vec3 unitDirection = direction / dirLength;
 
-							const auto materialColorCache = material->buildBsdfCache(scene->getAmbientColor(), isectProps.texCoord);
+				for (nbUint32 i = 0u; i < nbSamples; ++i)
+				{
+					nbFloat32 weight;
+					const nbFloat32 t = sampleFreeFlight(stream.generateUnsignedNormalized(), extinction, dirLength, weight);
+					const glm::vec3 currentPt = startPt + unitDirection * t;
 
-							const nbFloat32 distanceFactor = std::exp2f(-isectResult.meshIntersectData.packetIntersectionResult.t
-							* media->getExtinctionCoeff());
+					for (nbUint32 lightIdx = 0u; lightIdx < lights.size(); ++lightIdx)
+					{
+						if (samplingSettings.m_mode == VolumeSamplingMode::Equiangular && lights.getType(lightIdx) == Light::Point)
+						{
+							// Dedicated distance toward this light.
+							nbFloat32 lightWeight;
+							const nbFloat32 lightT = sampleEquiangular(stream.generateUnsignedNormalized(), startPt, unitDirection, dirLength,
+								lights.getPosition(lightIdx), extinction, lightWeight);
 
-							indirectRadiance += distanceFactor * DirectLightningIntegrator::sample(scene->getLights(),
-								intersector,
-								*material,
-								materialColorCache,
-								isectProps);
+							accInRadiance += lightWeight * sampleInScattering(intersector, lights, lightIdx, startPt + unitDirection * lightT, direction, media, stream);
 						}
 						else
 						{
-							nbFloat32 phase = media->sample(direction, sample);
-							indirectRadiance += phase * getSkyColor(scene, ray);
+							accInRadiance += weight * sampleInScattering(intersector, lights, lightIdx, currentPt, direction, media, stream);
 						}
 					}
+
+					if (mediaSettings.m_multipleStattering)
+						addIndirectSamples(currentPt, weight);
 				}
+			}
+
+			if (!indirectRays.empty())
+			{
+				// Compute indirect contributions.
+				std::vector<Intersector::IntersectionInfo>& isectResults = buffers->isectResults;
+				std::vector<nbUint8>& hits = buffers->hits;
+				indirectRays.intersect(intersector, isectResults, hits);
+
+				std::vector<nbFloat32>& hitTransmittances = buffers->hitTransmittances;
+				computeHitTransmittances(isectResults, hits, extinction, hitTransmittances);
 
-				accInRadiance += directRadiance + indirectRadiance;
+				for (nbUint32 i = 0u; i < indirectRays.size(); ++i)
+				{
+					const Math::Ray ray = indirectRays.getRay(i);
+
+					if (hits[i])
+					{
+						accInRadiance += (indirectWeights[i] * hitTransmittances[i]) * PackedSpectrum(shadeIndirectHit(intersector, scene, lights, ray, isectResults[i], samplingSettings, indirectCones[i], stream));
+					}
+					else
+					{
+						nbFloat32 phase = media->sample(direction, ray.m_direction);
+						accInRadiance += (indirectWeights[i] * phase) * PackedSpectrum(getSkyColor(scene, ray));
+					}
+				}
 			}
 
-			accInRadiance /= nbSamples;
+			accInRadiance /= (nbFloat32)nbSamples;
 		}
 
+		if (budget)
+			budget->release(nbSamples);
+
 		// Reduced surface radiance
-		const nbFloat32 transmittance = std::exp2f(-dirLength * media->getExtinctionCoeff());
+		const nbFloat32 transmittance = fastExp2(-dirLength * extinction);
+
+		const PackedSpectrum reducedRadiance = PackedSpectrum(inRadiance) * transmittance;
+
+		return ((reducedRadiance + accInRadiance) * (mediaSettings.m_noise ? stream.generateBeetween(0.8f, 1.0f) : 1.0f)).toSpectrum();
+	}
+
+	PackedSpectrum VolumeIntegrator::sampleInScattering(const Intersector::BaseIntersectorPtr& intersector,
+		const LightSnapshot& lights,
+		nbUint32 lightIdx,
+		const glm::vec3& point,
+		const glm::vec3& direction,
+		const MediaPtr& media,
+		SampleStream& stream)
+	{
+		const auto sampleToLight = lights.getLight(lightIdx).generateSampleToLight(stream, point);
+		if (!sampleToLight.canProcess)
+			return BlackRGBSpectrum;
+
+		const Math::Ray sRay(point, sampleToLight.L, sampleToLight.length);
+		const nbFloat32 occlusionStrength = intersector->occlusion(sRay);
+
+		return computeInScattering(lights, lightIdx, sampleToLight.L, sampleToLight.length, direction, media, occlusionStrength);
+	}
+
+	PackedSpectrum VolumeIntegrator::sampleInScattering(const LightSnapshot& lights,
+		nbUint32 lightIdx,
+		const glm::vec3& point,
+		const glm::vec3& direction,
+		const MediaPtr& media,
+		nbFloat32 occlusionStrength,
+		SampleStream& stream)
+	{
+		if (occlusionStrength >= 1.0f)
+			return BlackRGBSpectrum;
+
+		const auto sampleToLight = lights.getLight(lightIdx).generateSampleToLight(stream, point);
+		if (!sampleToLight.canProcess)
+			return BlackRGBSpectrum;
+
+		return computeInScattering(lights, lightIdx, sampleToLight.L, sampleToLight.length, direction, media, occlusionStrength);
+	}
+
+	PackedSpectrum VolumeIntegrator::computeInScattering(const LightSnapshot& lights,
+		nbUint32 lightIdx,
+		const glm::vec3& L,
+		nbFloat32 lightDistance,
+		const glm::vec3& direction,
+		const MediaPtr& media,
+		nbFloat32 occlusionStrength)
+	{
+		if (occlusionStrength >= 1.0f)
+			return BlackRGBSpectrum;
+
+		const nbFloat32 phase = media->sample(direction, L);
+		const nbFloat32 distanceFactor = lights.getType(lightIdx) != Light::Point ? 1.0f :
+			fastExp2(-lightDistance * media->getExtinctionCoeff());
+
+		return lights.getPackedColor(lightIdx) * (phase * distanceFactor * (1.0f - occlusionStrength));
+	}
+
+	Spectrum VolumeIntegrator::shadeIndirectHit(const Intersector::BaseIntersectorPtr& intersector,
+		const Scene::BaseScene* scene,
+		const LightSnapshot& lights,
+		const Math::Ray& ray,
+		const Intersector::IntersectionInfo& isectResult,
+		const VolumeSamplingSettings& samplingSettings,
+		const RayCone& rayCone,
+		SampleStream& stream)
+	{
+		const auto isectProps = buildIntersectionProperties(ray, isectResult, scene, samplingSettings.m_vertexCache, samplingSettings.m_textureTable, rayCone);
+		const auto material = scene->getModel()->getMaterialFromEntityOrDefault(isectResult.object->getMaterialId());
+
+		const auto materialColorCache = material->buildBsdfCache(scene->getAmbientColor(), isectProps.texCoord);
+
+		return DirectLightningIntegrator::sample(lights,
+			intersector,
+			*material,
+			materialColorCache,
+			isectProps,
+			stream);
+	}
+
+	void VolumeIntegrator::computeHitTransmittances(const std::vector<Intersector::IntersectionInfo>& isectResults,
+		const std::vector<nbUint8>& hits,
+		nbFloat32 extinction,
+		std::vector<nbFloat32>& dst)
+	{
+		const nbUint32 nbRays = (nbUint32)hits.size();
+		dst.resize(nbRays);
+
+		for (nbUint32 i = 0u; i < nbRays; ++i)
+			dst[i] = hits[i] ? -isectResults[i].meshIntersectData.packetIntersectionResult.t * extinction : 0.0f;
+
+		fastExp2(dst.data(), dst.data(), nbRays);
+	}
+
+	void VolumeIntegrator::buildIrradianceProbe(const Intersector::BaseIntersectorPtr& intersector,
+		const Scene::BaseScene* scene,
+		const LightSnapshot& lights,
+		nbFloat32 extinction,
+		const glm::vec3& position,
+		nbUint32 nbRays,
+		const VolumeSamplingSettings& samplingSettings,
+		SampleStream& stream,
+		IrradianceProbe& dst)
+	{
+		const IndirectRayBuffersLease buffers;
+		RayBatch& probeRays = buffers->rays;
+		probeRays.reserve(nbRays);
+
+		for (nbUint32 i = 0u; i < nbRays; ++i)
+		{
+			const nbFloat32 r1 = stream.generateSignedNormalized();
+			const nbFloat32 r2 = stream.generateUnsignedNormalized();
+			probeRays.add(position, Math::uniformSphericalSample(r1, r2));
+		}
+
+		std::vector<Intersector::IntersectionInfo>& isectResults = buffers->isectResults;
+		std::vector<nbUint8>& hits = buffers->hits;
+		probeRays.intersect(intersector, isectResults, hits);
+
+		std::vector<nbFloat32>& hitTransmittances = buffers->hitTransmittances;
+		computeHitTransmittances(isectResults, hits, extinction, hitTransmittances);
+
+		dst.surfaceRadiance = PackedSpectrum();
+		dst.skyRadiance = PackedSpectrum();
+
+		// Probes are shared by all the rays passing by, they have no footprint of their own and read the finest MIP level.
+		const RayCone probeCone;
+
+		for (nbUint32 i = 0u; i < nbRays; ++i)
+		{
+			const Math::Ray ray = probeRays.getRay(i);
+
+			if (hits[i])
+				dst.surfaceRadiance += hitTransmittances[i] * PackedSpectrum(shadeIndirectHit(intersector, scene, lights, ray, isectResults[i], samplingSettings, probeCone, stream));
+			else
+				dst.skyRadiance += getSkyColor(scene, ray);
+		}
+
+		dst.surfaceRadiance /= (nbFloat32)nbRays;
+		dst.skyRadiance /= (nbFloat32)nbRays;
+	}
+
+	nbFloat32 VolumeIntegrator::sampleFreeFlight(nbFloat32 u, nbFloat32 extinction, nbFloat32 length, nbFloat32& weight)
+	{
+		// Transmittance is exp2(-extinction * t). Sample it truncated to the segment.
+		const nbFloat32 segmentOpacity = 1.0f - fastExp2(-extinction * length);
+		if (segmentOpacity < 1e-4f)
+		{
+			// Nearly transparent, uniform sampling.
+			weight = 1.0f;
+			return u * length;
+		}
+
+		static const nbFloat32 ln2 = 0.69314718f;
+		const nbFloat32 t = std::min(-std::log2(1.0f - u * segmentOpacity) / extinction, length);
+
+		// transmittance / (pdf * length) is constant.
+		weight = segmentOpacity / (extinction * ln2 * length);
+		return t;
+	}
+
+	nbFloat32 VolumeIntegrator::sampleEquiangular(nbFloat32 u, const glm::vec3& startPt, const glm::vec3& unitDirection, nbFloat32 length,
+		const glm::vec3& lightPosition, nbFloat32 extinction, nbFloat32& weight)
+	{
+		// Distance along the segment of the point closest to the light, and distance of the light to the line.
+		const nbFloat32 delta = glm::dot(lightPosition - startPt, unitDirection);
+		const nbFloat32 D = std::max(glm::length(startPt + unitDirection * delta - lightPosition), 1e-4f);
+
+		const nbFloat32 thetaA = std::atan2(-delta, D);
+		const nbFloat32 thetaB = std::atan2(length - delta, D);
+
+		const nbFloat32 x = D * std::tan(thetaA + u * (thetaB - thetaA));
+		const nbFloat32 t = glm::clamp(delta + x, 0.0f, length);
 
-		const Spectrum reducedRadiance = inRadiance * transmittance;
+		const nbFloat32 pdf = D / ((thetaB - thetaA) * (D * D + x * x));
+		weight = fastExp2(-extinction * t) / (pdf * length);
 
-		return (reducedRadiance + accInRadiance) * (mediaSettings.m_noise ? s_nbGenerator.generateBeetween(0.8f, 1.0f) : 1.0f);
+		return t;
 	}
 
 }}}}
\ No newline at end of file
@@ -8,16 +8,122 @@
 #pragma once
 
 #include "BaseIntegrator.h"
+#include "LightSnapshot.h"
+#include "VolumeIrradianceCache.h"
+#include "VolumeSampleBudget.h"
 
 namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
 {
+// How the in-scattering points along a segment are chosen.
+enum class VolumeSamplingMode
+{
+	// nbSamples regular steps.
+	RayMarching,
+
+	// Distances sampled per point light proportionally to the inverse squared distance to the light.
+	// Other lights and indirect rays use FreeFlight.
+	// @See: Kulla and Fajardo, Importance Sampling Techniques for Path Tracing in Participating Media
+	Equiangular,
+
+	// Distances sampled proportionally to the transmittance of an homogeneous media.
+	FreeFlight
+};
+
+struct VolumeSamplingSettings
+{
+	VolumeSamplingMode m_mode = VolumeSamplingMode::RayMarching;
+
+	// RayMarching only. When above one, light occlusion is traced every m_visibilityStride steps
+	// and reused in between where it does not change. @See: SegmentVisibilityCache.
+	nbUint32 m_visibilityStride = 0u;
+
+	// Bounds the number of samples of the segments and refines the noisy ray marched ones.
+	// Without it, the number of samples is only clamped to [1, s_maxNbSamples].
+	VolumeSampleBudget* m_budget = nullptr;
+
+	// When set, multiple scattering reads the cached irradiance probes instead of shading two surface hits per sample.
+	VolumeIrradianceCache* m_irradianceCache = nullptr;
+
+	// Optional, used to shade the surfaces hit by indirect rays. @See: buildIntersectionProperties.
+	// The vertex cache is not validated here, the caller validates it once before rendering.
+	ShadingVertexCache* m_vertexCache = nullptr;
+	TextureTable* m_textureTable = nullptr;
+};
+
 struct VolumeIntegrator : BaseIntegrator
 {
+	// Unlike the ray marcher, the Equiangular and FreeFlight modes attenuate the in-scattered light by the
+	// transmittance toward startPt. They converge with far fewer samples.
+	// rayCone is the footprint of the ray at startPt, the indirect rays leave the segment with it widened.
 	static Spectrum sample(const Intersector::BaseIntersectorPtr& intersector,
 		const Scene::BaseScene* scene,
+		const LightSnapshot& lights,
 		const Spectrum& inRadiance,
 		const glm::vec3& startPt,
 		const glm::vec3& endPt,
-		const MediaPtr& media);
+		const MediaPtr& media,
+		SampleStream& stream,
+		const VolumeSamplingSettings& samplingSettings = VolumeSamplingSettings(),
+		const RayCone& rayCone = RayCone());
+
+private:
+	static const nbUint32 s_maxNbSamples;
+
+	// Direct light in-scattered at a point of the segment.
+	static PackedSpectrum sampleInScattering(const Intersector::BaseIntersectorPtr& intersector,
+		const LightSnapshot& lights,
+		nbUint32 lightIdx,
+		const glm::vec3& point,
+		const glm::vec3& direction,
+		const MediaPtr& media,
+		SampleStream& stream);
+
+	// Same with an already known occlusion.
+	static PackedSpectrum sampleInScattering(const LightSnapshot& lights,
+		nbUint32 lightIdx,
+		const glm::vec3& point,
+		const glm::vec3& direction,
+		const MediaPtr& media,
+		nbFloat32 occlusionStrength,
+		SampleStream& stream);
+
+	static PackedSpectrum computeInScattering(const LightSnapshot& lights,
+		nbUint32 lightIdx,
+		const glm::vec3& L,
+		nbFloat32 lightDistance,
+		const glm::vec3& direction,
+		const MediaPtr& media,
+		nbFloat32 occlusionStrength);
+
+	// Direct light reflected toward the media by the surface hit by an indirect ray, before attenuation.
+	static Spectrum shadeIndirectHit(const Intersector::BaseIntersectorPtr& intersector,
+		const Scene::BaseScene* scene,
+		const LightSnapshot& lights,
+		const Math::Ray& ray,
+		const Intersector::IntersectionInfo& isectResult,
+		const VolumeSamplingSettings& samplingSettings,
+		const RayCone& rayCone,
+		SampleStream& stream);
+
+	// Media transmittance up to each hit, computed in one vectorized pass.
+	static void computeHitTransmittances(const std::vector<Intersector::IntersectionInfo>& isectResults,
+		const std::vector<nbUint8>& hits,
+		nbFloat32 extinction,
+		std::vector<nbFloat32>& dst);
+
+	static void buildIrradianceProbe(const Intersector::BaseIntersectorPtr& intersector,
+		const Scene::BaseScene* scene,
+		const LightSnapshot& lights,
+		nbFloat32 extinction,
+		const glm::vec3& position,
+		nbUint32 nbRays,
+		const VolumeSamplingSettings& samplingSettings,
+		SampleStream& stream,
+		IrradianceProbe& dst);
+
+	// Distance in [0, length] and its weight, the transmittance over the distance pdf times the length.
+	static nbFloat32 sampleFreeFlight(nbFloat32 u, nbFloat32 extinction, nbFloat32 length, nbFloat32& weight);
+	static nbFloat32 sampleEquiangular(nbFloat32 u, const glm::vec3& startPt, const glm::vec3& unitDirection, nbFloat32 length,
+		const glm::vec3& lightPosition, nbFloat32 extinction, nbFloat32& weight);
 };
 }}}}
\ No newline at end of file
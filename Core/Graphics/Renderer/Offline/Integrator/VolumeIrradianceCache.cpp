@@ -0,0 +1,92 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#include "stdafx.h"
+#include "VolumeIrradianceCache.h"
+#include <cstring>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+	namespace
+	{
+		// 21 bits per axis.
+		nbUint64 getVertexKey(const glm::ivec3& vertex)
+		{
+			static const nbUint64 mask = (1u << 21u) - 1u;
+
+			return ((nbUint64)vertex.x & mask) |
+				(((nbUint64)vertex.y & mask) << 21u) |
+				(((nbUint64)vertex.z & mask) << 42u);
+		}
+
+		nbUint32 getBits(nbFloat32 value)
+		{
+			nbUint32 bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			return bits;
+		}
+	}
+
+	VolumeIrradianceCache::VolumeIrradianceCache(const Scene::BaseScene* scene, const VolumeIrradianceCacheSettings& settings)
+	: m_settings(settings)
+	{
+		m_settings.m_resolution = std::max(1u, m_settings.m_resolution);
+		m_settings.m_nbRaysPerProbe = std::max(1u, m_settings.m_nbRaysPerProbe);
+
+		const nbFloat32 boundsSize = glm::length(scene->getModel()->getBounds().getSize());
+		m_cellSize = std::max(boundsSize / m_settings.m_resolution, 1e-4f);
+	}
+
+	size_t VolumeIrradianceCache::ProbeKeyHash::operator()(const ProbeKey& key) const
+	{
+		return std::hash<nbUint64>()(getVertexKey(key.vertex) ^ ((nbUint64)getBits(key.extinction) * 0x9e3779b97f4a7c15ull));
+	}
+
+	IrradianceProbe VolumeIrradianceCache::lookup(const glm::vec3& point, nbFloat32 extinction, const BuildProbeFunc& buildProbe)
+	{
+		const glm::vec3 gridPoint = point / m_cellSize;
+		const glm::vec3 origin = glm::floor(gridPoint);
+		const glm::vec3 w = gridPoint - origin;
+		const glm::ivec3 originVertex = glm::ivec3(origin);
+
+		IrradianceProbe result;
+
+		for (nbUint32 i = 0u; i < 8u; ++i)
+		{
+			const glm::ivec3 offset((i & 1u) ? 1 : 0, (i & 2u) ? 1 : 0, (i & 4u) ? 1 : 0);
+
+			const nbFloat32 weight = (offset.x ? w.x : 1.0f - w.x) *
+				(offset.y ? w.y : 1.0f - w.y) *
+				(offset.z ? w.z : 1.0f - w.z);
+
+			if (weight <= 0.0f)
+				continue;
+
+			const IrradianceProbe& probe = fetch({ originVertex + offset, extinction }, buildProbe);
+
+			result.surfaceRadiance += weight * probe.surfaceRadiance;
+			result.skyRadiance += weight * probe.skyRadiance;
+		}
+
+		return result;
+	}
+
+	const IrradianceProbe& VolumeIrradianceCache::fetch(const ProbeKey& key, const BuildProbeFunc& buildProbe)
+	{
+		return m_probes.getOrBuild(key, [&]()
+		{
+			const nbUint64 vertexKey = getVertexKey(key.vertex);
+
+			IrradianceProbe probe;
+			SampleStream stream((nbUint32)vertexKey ^ getBits(key.extinction), (nbUint32)(vertexKey >> 32u));
+			buildProbe(glm::vec3(key.vertex) * m_cellSize, m_settings.m_nbRaysPerProbe, stream, probe);
+
+			return probe;
+		});
+	}
+
+}}}}
\ No newline at end of file
@@ -0,0 +1,96 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include "BuildOnceMap.h"
+#include "SampleStream.h"
+#include "Spectrum.h"
+#include "Scene/BaseScene.h"
+#include <functional>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+struct VolumeIrradianceCacheSettings
+{
+	// Number of cells along the scene bounds diagonal.
+	nbUint32 m_resolution = 64u;
+
+	nbUint32 m_nbRaysPerProbe = 64u;
+};
+
+// Mean radiance reaching a point of a media, split by origin because only the sky is weighted by the phase function.
+// Packed because probes are only read by the packed accumulation of VolumeIntegrator.
+struct IrradianceProbe
+{
+	// Direct light reflected by the surfaces, attenuated by the media.
+	PackedSpectrum surfaceRadiance;
+
+	// Sky radiance of the rays leaving the scene.
+	PackedSpectrum skyRadiance;
+};
+
+// Sparse grid of irradiance probes used for multiple scattering.
+// Probes live at the grid vertices. They are built lazily on first lookup and shared between the render threads,
+// so each one costs m_nbRaysPerProbe rays once instead of two full shadings per march step.
+// A lookup interpolates the eight probes around the point. Probes inside geometry may leak light near surfaces.
+// Probes depend on the media only through its extinction, they are keyed by it so media with different
+// extinctions, or a media whose extinction changed, never read each other's probes.
+class VolumeIrradianceCache
+{
+public:
+	// Traces the probe rays. The stream is seeded from the probe position so probes do not depend on the thread building them.
+	using BuildProbeFunc = std::function<void(const glm::vec3& position, nbUint32 nbRays, SampleStream& stream, IrradianceProbe& dst)>;
+
+	VolumeIrradianceCache(const Scene::BaseScene* scene, const VolumeIrradianceCacheSettings& settings = VolumeIrradianceCacheSettings());
+
+	// extinction is the one of the media buildProbe traces in.
+	IrradianceProbe lookup(const glm::vec3& point, nbFloat32 extinction, const BuildProbeFunc& buildProbe);
+
+	// Must be called when the scene changes. Not thread safe, never call it while rendering.
+	void invalidate();
+
+	nbUint32 getNbProbes() const;
+
+private:
+	struct ProbeKey
+	{
+		glm::ivec3 vertex;
+		nbFloat32 extinction;
+
+		nbBool operator==(const ProbeKey& other) const;
+	};
+
+	struct ProbeKeyHash
+	{
+		size_t operator()(const ProbeKey& key) const;
+	};
+
+	const IrradianceProbe& fetch(const ProbeKey& key, const BuildProbeFunc& buildProbe);
+
+	VolumeIrradianceCacheSettings m_settings;
+	nbFloat32 m_cellSize;
+
+	// A probe costs m_nbRaysPerProbe shaded rays, threads needing a probe being built wait for it.
+	BuildOnceMap<ProbeKey, IrradianceProbe, ProbeKeyHash> m_probes;
+};
+
+inline void VolumeIrradianceCache::invalidate()
+{
+	m_probes.clear();
+}
+
+inline nbUint32 VolumeIrradianceCache::getNbProbes() const
+{
+	return m_probes.size();
+}
+
+inline nbBool VolumeIrradianceCache::ProbeKey::operator==(const ProbeKey& other) const
+{
+	return vertex == other.vertex && extinction == other.extinction;
+}
+}}}}
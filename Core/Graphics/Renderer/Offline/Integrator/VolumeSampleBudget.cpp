@@ -0,0 +1,94 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#include "stdafx.h"
+#include "VolumeSampleBudget.h"
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+	VolumeSampleBudget::VolumeSampleBudget(const VolumeSampleBudgetSettings& settings)
+	: m_settings(settings)
+	{
+		m_settings.m_minSamples = std::max(1u, m_settings.m_minSamples);
+		m_settings.m_maxSamples = std::max(m_settings.m_minSamples, m_settings.m_maxSamples);
+
+		beginFrame();
+	}
+
+	void VolumeSampleBudget::beginFrame()
+	{
+		m_nbSegments.store(0u);
+		m_nbSamples.store(0u);
+		m_nbRefinements.store(0u);
+		m_nbClampedSegments.store(0u);
+		m_nbOverBudgetSegments.store(0u);
+		m_maxSegmentSamples.store(0u);
+	}
+
+	nbUint32 VolumeSampleBudget::acquire(nbFloat32 requested)
+	{
+		m_nbSegments.fetch_add(1u);
+
+		// NaN fails both comparisons and is clamped to the minimum.
+		nbUint32 nbSamples = m_settings.m_minSamples;
+		if (requested > (nbFloat32)m_settings.m_maxSamples)
+			nbSamples = m_settings.m_maxSamples;
+		else if (requested >= (nbFloat32)m_settings.m_minSamples)
+			nbSamples = (nbUint32)requested;
+
+		if (!(requested >= (nbFloat32)m_settings.m_minSamples && requested <= (nbFloat32)m_settings.m_maxSamples))
+			m_nbClampedSegments.fetch_add(1u);
+
+		if (nbSamples > m_settings.m_minSamples && !reserve(nbSamples))
+		{
+			m_nbOverBudgetSegments.fetch_add(1u);
+			nbSamples = m_settings.m_minSamples;
+		}
+
+		return nbSamples;
+	}
+
+	nbUint32 VolumeSampleBudget::acquireRefinement(nbUint32 nbSamples)
+	{
+		if (m_settings.m_noiseThreshold <= 0.0f || 2u * nbSamples > m_settings.m_maxSamples || !reserve(nbSamples))
+			return 0u;
+
+		m_nbRefinements.fetch_add(1u);
+		return nbSamples;
+	}
+
+	void VolumeSampleBudget::release(nbUint32 nbSamples)
+	{
+		m_nbSamples.fetch_add(nbSamples);
+
+		nbUint32 maxSamples = m_maxSegmentSamples.load();
+		while (nbSamples > maxSamples && !m_maxSegmentSamples.compare_exchange_weak(maxSamples, nbSamples));
+	}
+
+	nbBool VolumeSampleBudget::reserve(nbUint64 nbSamples)
+	{
+		if (!m_settings.m_frameBudget)
+			return true;
+
+		// Samples are counted when released. Segments in flight may overshoot the budget by a few segments.
+		return m_nbSamples.load() + nbSamples <= m_settings.m_frameBudget;
+	}
+
+	VolumeSampleBudgetStats VolumeSampleBudget::getStats() const
+	{
+		VolumeSampleBudgetStats stats;
+		stats.nbSegments = m_nbSegments.load();
+		stats.nbSamples = m_nbSamples.load();
+		stats.nbRefinements = m_nbRefinements.load();
+		stats.nbClampedSegments = m_nbClampedSegments.load();
+		stats.nbOverBudgetSegments = m_nbOverBudgetSegments.load();
+		stats.maxSegmentSamples = m_maxSegmentSamples.load();
+
+		return stats;
+	}
+
+}}}}
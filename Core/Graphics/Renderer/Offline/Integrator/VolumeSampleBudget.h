@@ -0,0 +1,82 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include <atomic>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+struct VolumeSampleBudgetSettings
+{
+	// Bounds of the number of samples of a segment, refinements included.
+	nbUint32 m_minSamples = 4u;
+	nbUint32 m_maxSamples = 256u;
+
+	// Relative standard error of the in-scattered light above which a ray marched segment doubles its steps.
+	// Zero disables refinement.
+	nbFloat32 m_noiseThreshold = 0.05f;
+
+	// Total number of samples of all the segments of a frame. Once spent, segments get m_minSamples.
+	// Zero is unlimited.
+	nbUint64 m_frameBudget = 0u;
+};
+
+struct VolumeSampleBudgetStats
+{
+	nbUint64 nbSegments = 0u;
+	nbUint64 nbSamples = 0u;
+	nbUint64 nbRefinements = 0u;
+
+	// Segments whose requested number of samples was out of bounds.
+	nbUint64 nbClampedSegments = 0u;
+
+	// Segments which got m_minSamples because the frame budget was spent.
+	nbUint64 nbOverBudgetSegments = 0u;
+
+	nbUint32 maxSegmentSamples = 0u;
+};
+
+// Number of samples handed to the volume segments of a frame.
+// Shared by all the render threads, beginFrame() must be called before rendering a frame.
+class VolumeSampleBudget
+{
+public:
+	explicit VolumeSampleBudget(const VolumeSampleBudgetSettings& settings = VolumeSampleBudgetSettings());
+
+	void beginFrame();
+
+	// Samples of a new segment. requested may be any value, infinite included.
+	nbUint32 acquire(nbFloat32 requested);
+
+	// Extra samples to refine a segment already having nbSamples. Zero when the segment can not be refined.
+	nbUint32 acquireRefinement(nbUint32 nbSamples);
+
+	// Called once a segment is done.
+	void release(nbUint32 nbSamples);
+
+	const VolumeSampleBudgetSettings& getSettings() const;
+	VolumeSampleBudgetStats getStats() const;
+
+private:
+	nbBool reserve(nbUint64 nbSamples);
+
+	VolumeSampleBudgetSettings m_settings;
+
+	std::atomic<nbUint64> m_nbSegments;
+	std::atomic<nbUint64> m_nbSamples;
+	std::atomic<nbUint64> m_nbRefinements;
+	std::atomic<nbUint64> m_nbClampedSegments;
+	std::atomic<nbUint64> m_nbOverBudgetSegments;
+	std::atomic<nbUint32> m_maxSegmentSamples;
+};
+
+inline const VolumeSampleBudgetSettings& VolumeSampleBudget::getSettings() const
+{
+	return m_settings;
+}
+}}}}
@@ -0,0 +1,183 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#include "stdafx.h"
+#include "WavefrontIntegrator.h"
+#include "tbb/tbb.h"
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+	WavefrontIntegrator::WavefrontIntegrator(const Scene::BaseScene* scene,
+		const LightSampler& lightSampler,
+		nbUint32 nbLightSamples,
+		ShadingVertexCache* vertexCache,
+		TextureTable* textureTable)
+	: m_scene(scene)
+	, m_lightSampler(lightSampler)
+	, m_nbLightSamples(nbLightSamples)
+	, m_vertexCache(vertexCache)
+	, m_textureTable(textureTable)
+	{
+	}
+
+	void WavefrontIntegrator::integrate(const Intersector::BaseIntersectorPtr& intersector,
+		const std::vector<WavefrontRay>& rays,
+		std::vector<Spectrum>& radiances)
+	{
+		radiances.assign(rays.size(), BlackRGBSpectrum);
+
+		// Meshes may have moved since the last integration.
+		if (m_vertexCache)
+			m_vertexCache->validate();
+
+		intersectStage(intersector, rays);
+		sortStage(rays, radiances);
+		shadeStage(rays);
+		shadowStage(intersector, radiances);
+	}
+
+	void WavefrontIntegrator::intersectStage(const Intersector::BaseIntersectorPtr& intersector, const std::vector<WavefrontRay>& rays)
+	{
+		const nbUint32 nbRays = (nbUint32)rays.size();
+		m_hits.resize(nbRays);
+
+		tbb::parallel_for(tbb::blocked_range<nbUint32>(0u, nbRays, s_grainSize), [&](const tbb::blocked_range<nbUint32>& range)
+		{
+			for (nbUint32 i = range.begin(); i != range.end(); ++i)
+			{
+				Hit& hit = m_hits[i];
+				hit.found = intersector->intersect(rays[i].ray, hit.info);
+				hit.materialKey = hit.found ? hit.info.object->getMaterialId().getValue() : 0u;
+			}
+		});
+	}
+
+	void WavefrontIntegrator::sortStage(const std::vector<WavefrontRay>& rays, std::vector<Spectrum>& radiances)
+	{
+		m_shadeQueue.clear();
+
+		for (nbUint32 i = 0u; i < m_hits.size(); ++i)
+		{
+			if (m_hits[i].found)
+				m_shadeQueue.push_back(i);
+			else
+				radiances[i] = rays[i].throughput * getSkyColor(m_scene, rays[i].ray, true);
+		}
+
+		// Stable on ray index so the shading order does not depend on the sort implementation.
+		tbb::parallel_sort(m_shadeQueue.begin(), m_shadeQueue.end(), [this](nbUint32 a, nbUint32 b)
+		{
+			const nbUint32 keyA = m_hits[a].materialKey;
+			const nbUint32 keyB = m_hits[b].materialKey;
+			return keyA != keyB ? keyA < keyB : a < b;
+		});
+	}
+
+	void WavefrontIntegrator::shadeStage(const std::vector<WavefrontRay>& rays)
+	{
+		const nbUint32 nbShadowRaysPerHit = getNbShadowRaysPerHit();
+		const nbBool processAllLights = nbShadowRaysPerHit == m_lightSampler.getNbLights();
+		const LightSnapshot& lights = m_lightSampler.getLights();
+
+		const nbUint32 nbHits = (nbUint32)m_shadeQueue.size();
+		m_shadowQueue.resize(nbHits * nbShadowRaysPerHit);
+
+		if (!nbShadowRaysPerHit)
+			return;
+
+		const Model::ModelPtr& model = m_scene->getModel();
+
+		tbb::parallel_for(tbb::blocked_range<nbUint32>(0u, nbHits, s_grainSize), [&](const tbb::blocked_range<nbUint32>& range)
+		{
+			// Hits are sorted, the material only changes at batch boundaries.
+			Material::DatabaseMaterialPtr material;
+			nbUint32 materialKey = 0u;
+
+			for (nbUint32 q = range.begin(); q != range.end(); ++q)
+			{
+				const nbUint32 rayIdx = m_shadeQueue[q];
+				const Hit& hit = m_hits[rayIdx];
+				const WavefrontRay& ray = rays[rayIdx];
+
+				if (!material || hit.materialKey != materialKey)
+				{
+					material = model->getMaterialFromEntityOrDefault(hit.info.object->getMaterialId());
+					materialKey = hit.materialKey;
+				}
+
+				const auto isectProps = buildIntersectionProperties(ray.ray, hit.info, m_scene, m_vertexCache, m_textureTable, ray.cone);
+				const auto colorCache = material->buildBsdfCache(m_scene->getAmbientColor(), isectProps.texCoord);
+
+				SampleStream stream = ray.stream;
+
+				for (nbUint32 s = 0u; s < nbShadowRaysPerHit; ++s)
+				{
+					QueuedShadowRay& queued = m_shadowQueue[q * nbShadowRaysPerHit + s];
+
+					nbUint32 lightIdx = s;
+					nbFloat32 weight = 1.0f;
+
+					if (!processAllLights)
+					{
+						const LightPick pick = m_lightSampler.pick(stream);
+						lightIdx = pick.lightIdx;
+						weight = 1.0f / (pick.pdf * nbShadowRaysPerHit);
+					}
+
+					queued.active = DirectLightningIntegrator::generateShadowRay(lights, lightIdx, *material, colorCache, isectProps, stream, queued.ray);
+					if (queued.active)
+						queued.ray.contribution *= ray.throughput * weight;
+				}
+			}
+		});
+	}
+
+	void WavefrontIntegrator::shadowStage(const Intersector::BaseIntersectorPtr& intersector, std::vector<Spectrum>& radiances)
+	{
+		const nbUint32 nbShadowRaysPerHit = getNbShadowRaysPerHit();
+		const nbUint32 nbHits = (nbUint32)m_shadeQueue.size();
+
+		if (!nbShadowRaysPerHit)
+			return;
+
+		// The shadow rays of a hit are contiguous, each hit is accumulated by a single task.
+		tbb::parallel_for(tbb::blocked_range<nbUint32>(0u, nbHits, s_grainSize), [&](const tbb::blocked_range<nbUint32>& range)
+		{
+			for (nbUint32 q = range.begin(); q != range.end(); ++q)
+			{
+				Spectrum& radiance = radiances[m_shadeQueue[q]];
+
+				// Contributions are weighted by their visibility a packet at a time.
+				SpectrumN contributions;
+				nbFloat32 visibilities[SpectrumN::Size];
+
+				for (nbUint32 first = 0u; first < nbShadowRaysPerHit; first += SpectrumN::Size)
+				{
+					const nbUint32 count = std::min(SpectrumN::Size, nbShadowRaysPerHit - first);
+
+					contributions.setZero();
+					std::fill(std::begin(visibilities), std::end(visibilities), 0.0f);
+
+					for (nbUint32 lane = 0u; lane < count; ++lane)
+					{
+						const QueuedShadowRay& queued = m_shadowQueue[q * nbShadowRaysPerHit + first + lane];
+						if (!queued.active)
+							continue;
+
+						const Math::Ray sRay(queued.ray.origin, queued.ray.direction, queued.ray.length);
+						contributions.set(lane, queued.ray.contribution);
+						visibilities[lane] = 1.0f - intersector->occlusion(sRay);
+					}
+
+					contributions.scale(visibilities);
+					radiance += contributions.sum();
+				}
+			}
+		});
+	}
+
+}}}}
\ No newline at end of file
@@ -0,0 +1,114 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include "DirectLightningIntegrator.h"
+#include <vector>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Integrator
+{
+struct WavefrontRay
+{
+	Math::Ray ray;
+	SampleStream stream;
+	Spectrum throughput;
+
+	// Footprint at the ray origin, filters the normal maps. Invalid cones read the finest MIP level.
+	RayCone cone;
+
+	// pixelCone is RayCone::fromPixel of the camera, computed once per frame.
+	static WavefrontRay fromCamera(const Math::Ray& ray, const SampleStream& stream, const RayCone& pixelCone);
+
+	// Ray leaving the hit of parent at distance hitT, the parent cone is widened up to the hit.
+	static WavefrontRay fromHit(const WavefrontRay& parent,
+		nbFloat32 hitT,
+		const Math::Ray& ray,
+		const SampleStream& stream,
+		const Spectrum& throughput,
+		nbFloat32 surfaceSpreadAngle = 0.0f);
+};
+
+// Streaming counterpart of the per pixel integrators.
+// Each stage runs over the whole ray queue before the next one starts:
+// 1 - Intersect all the rays.
+// 2 - Sort the hits by material.
+// 3 - Shade the hits in material batches and emit a shadow ray queue.
+// 4 - Trace the shadow rays and accumulate the visible contributions.
+// Queues are kept between calls so a render reuses the same memory.
+class WavefrontIntegrator : BaseIntegrator
+{
+public:
+	// nbLightSamples lights are picked per hit. Zero means all lights.
+	// lightSampler, and the snapshot it samples, are referenced and must outlive the integrator.
+	// vertexCache is validated by each integrate, it must not be used by another integration running meanwhile.
+	WavefrontIntegrator(const Scene::BaseScene* scene,
+		const LightSampler& lightSampler,
+		nbUint32 nbLightSamples,
+		ShadingVertexCache* vertexCache = nullptr,
+		TextureTable* textureTable = nullptr);
+
+	// Radiance carried back along each ray.
+	void integrate(const Intersector::BaseIntersectorPtr& intersector,
+		const std::vector<WavefrontRay>& rays,
+		std::vector<Spectrum>& radiances);
+
+private:
+	struct Hit
+	{
+		Intersector::IntersectionInfo info;
+		nbUint32 materialKey;
+		nbBool found;
+	};
+
+	struct QueuedShadowRay
+	{
+		ShadowRay ray;
+		nbBool active;
+	};
+
+	void intersectStage(const Intersector::BaseIntersectorPtr& intersector, const std::vector<WavefrontRay>& rays);
+	void sortStage(const std::vector<WavefrontRay>& rays, std::vector<Spectrum>& radiances);
+	void shadeStage(const std::vector<WavefrontRay>& rays);
+	void shadowStage(const Intersector::BaseIntersectorPtr& intersector, std::vector<Spectrum>& radiances);
+
+	nbUint32 getNbShadowRaysPerHit() const;
+
+	static constexpr nbUint32 s_grainSize = 256u;
+
+	const Scene::BaseScene* m_scene;
+	const LightSampler& m_lightSampler;
+	nbUint32 m_nbLightSamples;
+	ShadingVertexCache* m_vertexCache;
+	TextureTable* m_textureTable;
+
+	std::vector<Hit> m_hits;
+	std::vector<nbUint32> m_shadeQueue;
+	std::vector<QueuedShadowRay> m_shadowQueue;
+};
+
+inline WavefrontRay WavefrontRay::fromCamera(const Math::Ray& ray, const SampleStream& stream, const RayCone& pixelCone)
+{
+	return WavefrontRay{ ray, stream, WhiteRGBSpectrum, pixelCone };
+}
+
+inline WavefrontRay WavefrontRay::fromHit(const WavefrontRay& parent,
+	nbFloat32 hitT,
+	const Math::Ray& ray,
+	const SampleStream& stream,
+	const Spectrum& throughput,
+	nbFloat32 surfaceSpreadAngle)
+{
+	return WavefrontRay{ ray, stream, throughput, parent.cone.propagate(hitT, surfaceSpreadAngle) };
+}
+
+inline nbUint32 WavefrontIntegrator::getNbShadowRaysPerHit() const
+{
+	const nbUint32 nbLights = m_lightSampler.getNbLights();
+	return (m_nbLightSamples == 0u || m_nbLightSamples >= nbLights) ? nbLights : m_nbLightSamples;
+}
+}}}}
\ No newline at end of file
@@ -0,0 +1,99 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#include "stdafx.h"
+#include "AdaptiveSampler.h"
+#include "tbb/tbb.h"
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Scheduler
+{
+	AdaptiveSampler::AdaptiveSampler(const glm::uvec2& imageSize, const TileArray& tiles, const AdaptiveSamplingSettings& settings)
+	: m_settings(settings)
+	, m_tiles(tiles)
+	, m_buffer(imageSize)
+	, m_tileNoises(tiles.size(), 0.0f)
+	{
+		m_settings.m_minSamples = std::max(2u, std::min(m_settings.m_minSamples, m_settings.m_maxSamples));
+		m_settings.m_samplesPerPass = std::max(1u, m_settings.m_samplesPerPass);
+	}
+
+	nbBool AdaptiveSampler::isPixelActive(nbUint32 pixelIdx) const
+	{
+		const nbUint32 nbSamples = m_buffer.getNbSamples(pixelIdx);
+
+		if (nbSamples >= m_settings.m_maxSamples)
+			return false;
+
+		if (nbSamples < m_settings.m_minSamples || m_settings.m_noiseThreshold <= 0.0f)
+			return true;
+
+		return m_buffer.getRelativeError(pixelIdx) > m_settings.m_noiseThreshold;
+	}
+
+	const TilePassArray& AdaptiveSampler::planPass()
+	{
+		m_pass.clear();
+
+		if (m_firstPass)
+		{
+			m_firstPass = false;
+
+			for (nbUint32 i = 0u; i < m_tiles.size(); ++i)
+				m_pass.push_back({ i, m_settings.m_minSamples });
+
+			return m_pass;
+		}
+
+		// Noise of a tile is the summed error of its active pixels.
+		tbb::parallel_for(size_t(0), m_tiles.size(), [&](size_t i)
+		{
+			const Tile& tile = m_tiles[i];
+			nbFloat32 noise = 0.0f;
+
+			for (nbUint32 y = tile.min.y; y < tile.max.y; ++y)
+			{
+				for (nbUint32 x = tile.min.x; x < tile.max.x; ++x)
+				{
+					const nbUint32 pixelIdx = m_buffer.getPixelIdx(glm::uvec2(x, y));
+					if (isPixelActive(pixelIdx))
+						noise += m_settings.m_noiseThreshold > 0.0f ? std::min(m_buffer.getRelativeError(pixelIdx), 1.0f) : 1.0f;
+				}
+			}
+
+			m_tileNoises[i] = noise;
+		});
+
+		nbFloat32 totalNoise = 0.0f;
+		nbUint32 nbActiveTiles = 0u;
+
+		for (nbFloat32 noise : m_tileNoises)
+		{
+			totalNoise += noise;
+			nbActiveTiles += noise > 0.0f ? 1u : 0u;
+		}
+
+		if (!nbActiveTiles)
+			return m_pass;
+
+		// Share the budget of an uniform pass between the noisy tiles.
+		const nbFloat32 meanNoise = totalNoise / nbActiveTiles;
+
+		for (nbUint32 i = 0u; i < m_tiles.size(); ++i)
+		{
+			if (m_tileNoises[i] <= 0.0f)
+				continue;
+
+			const nbFloat32 share = m_tileNoises[i] / meanNoise;
+			const nbUint32 nbSamples = std::max(1u, (nbUint32)(m_settings.m_samplesPerPass * share + 0.5f));
+
+			m_pass.push_back({ i, std::min(nbSamples, m_settings.m_maxSamples) });
+		}
+
+		return m_pass;
+	}
+
+}}}}
\ No newline at end of file
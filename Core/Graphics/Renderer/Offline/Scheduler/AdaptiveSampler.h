@@ -0,0 +1,93 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include "ConvergenceBuffer.h"
+#include "Tile.h"
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Scheduler
+{
+struct AdaptiveSamplingSettings
+{
+	// Relative standard error under which a pixel stops being sampled. Zero disables adaptive sampling.
+	nbFloat32 m_noiseThreshold = 0.01f;
+
+	nbUint32 m_minSamples = 16u;
+	nbUint32 m_maxSamples = 1024u;
+
+	// Average number of samples per active pixel and per pass.
+	nbUint32 m_samplesPerPass = 8u;
+};
+
+struct TilePass
+{
+	nbUint32 tileIdx;
+	nbUint32 nbSamples;
+};
+
+using TilePassArray = std::vector<TilePass>;
+
+// Renders by passes. Every pixel first gets m_minSamples samples, then each pass stops sampling
+// converged pixels and shares the pass budget between the remaining tiles proportionally to their noise.
+//
+// Typical use:
+//	while (!sampler.planPass().empty())
+//		for each pass in parallel, for each pixel of the tile:
+//			take up to pass.nbSamples samples while needsSamples(pixel), seeding each one with sample index getNbSamples(pixel).
+class AdaptiveSampler
+{
+public:
+	AdaptiveSampler(const glm::uvec2& imageSize, const TileArray& tiles, const AdaptiveSamplingSettings& settings);
+
+	// Work of the next pass. Empty once all pixels converged or reached m_maxSamples.
+	const TilePassArray& planPass();
+
+	nbBool needsSamples(const glm::uvec2& pixel) const;
+	nbUint32 getNbSamples(const glm::uvec2& pixel) const;
+	void addSample(const glm::uvec2& pixel, const Spectrum& value);
+
+	const ConvergenceBuffer& getBuffer() const;
+	const TileArray& getTiles() const;
+
+private:
+	nbBool isPixelActive(nbUint32 pixelIdx) const;
+
+	AdaptiveSamplingSettings m_settings;
+	TileArray m_tiles;
+	ConvergenceBuffer m_buffer;
+
+	TilePassArray m_pass;
+	std::vector<nbFloat32> m_tileNoises;
+	nbBool m_firstPass = true;
+};
+
+inline nbBool AdaptiveSampler::needsSamples(const glm::uvec2& pixel) const
+{
+	return isPixelActive(m_buffer.getPixelIdx(pixel));
+}
+
+inline nbUint32 AdaptiveSampler::getNbSamples(const glm::uvec2& pixel) const
+{
+	return m_buffer.getNbSamples(m_buffer.getPixelIdx(pixel));
+}
+
+inline void AdaptiveSampler::addSample(const glm::uvec2& pixel, const Spectrum& value)
+{
+	m_buffer.addSample(m_buffer.getPixelIdx(pixel), value);
+}
+
+inline const ConvergenceBuffer& AdaptiveSampler::getBuffer() const
+{
+	return m_buffer;
+}
+
+inline const TileArray& AdaptiveSampler::getTiles() const
+{
+	return m_tiles;
+}
+}}}}
\ No newline at end of file
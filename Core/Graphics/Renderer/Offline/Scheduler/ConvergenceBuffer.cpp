@@ -0,0 +1,51 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#include "stdafx.h"
+#include "ConvergenceBuffer.h"
+#include <limits>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Scheduler
+{
+	ConvergenceBuffer::ConvergenceBuffer(const glm::uvec2& size)
+	: m_size(size)
+	, m_nbSamples(size.x * size.y, 0u)
+	, m_means(size.x * size.y, Integrator::BlackRGBSpectrum)
+	, m_luminanceMeans(size.x * size.y, 0.0f)
+	, m_luminanceM2(size.x * size.y, 0.0f)
+	{
+	}
+
+	void ConvergenceBuffer::addSample(nbUint32 pixelIdx, const Spectrum& value)
+	{
+		const nbUint32 n = ++m_nbSamples[pixelIdx];
+		const nbFloat32 invN = 1.0f / (nbFloat32)n;
+
+		m_means[pixelIdx] += (value - m_means[pixelIdx]) * invN;
+
+		const nbFloat32 luminance = Integrator::getLuminance(value);
+		const nbFloat32 delta = luminance - m_luminanceMeans[pixelIdx];
+
+		m_luminanceMeans[pixelIdx] += delta * invN;
+		m_luminanceM2[pixelIdx] += delta * (luminance - m_luminanceMeans[pixelIdx]);
+	}
+
+	nbFloat32 ConvergenceBuffer::getRelativeError(nbUint32 pixelIdx) const
+	{
+		const nbUint32 n = m_nbSamples[pixelIdx];
+		if (n < 2u)
+			return std::numeric_limits<nbFloat32>::max();
+
+		const nbFloat32 variance = m_luminanceM2[pixelIdx] / (nbFloat32)(n - 1u);
+		const nbFloat32 standardError = std::sqrt(variance / (nbFloat32)n);
+
+		// Dark pixels are compared to an absolute floor, otherwise they never converge.
+		static const nbFloat32 minLuminance = 1e-3f;
+		return standardError / std::max(m_luminanceMeans[pixelIdx], minLuminance);
+	}
+
+}}}}
\ No newline at end of file
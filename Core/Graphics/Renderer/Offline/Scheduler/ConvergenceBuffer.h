@@ -0,0 +1,64 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include "../Integrator/Spectrum.h"
+#include <vector>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Scheduler
+{
+using Integrator::Spectrum;
+
+// Per pixel running mean and variance of the samples, updated with Welford's algorithm.
+// Variance is tracked on luminance only. A pixel must only be updated by one thread at a time.
+// @See: https://en.wikipedia.org/wiki/Algorithms_for_calculating_variance#Welford's_online_algorithm
+class ConvergenceBuffer
+{
+public:
+	explicit ConvergenceBuffer(const glm::uvec2& size);
+
+	void addSample(nbUint32 pixelIdx, const Spectrum& value);
+
+	nbUint32 getPixelIdx(const glm::uvec2& pixel) const;
+	const glm::uvec2& getSize() const;
+
+	nbUint32 getNbSamples(nbUint32 pixelIdx) const;
+	const Spectrum& getMean(nbUint32 pixelIdx) const;
+
+	// Standard error of the mean over the mean luminance.
+	nbFloat32 getRelativeError(nbUint32 pixelIdx) const;
+
+private:
+	glm::uvec2 m_size;
+
+	std::vector<nbUint32> m_nbSamples;
+	std::vector<Spectrum> m_means;
+	std::vector<nbFloat32> m_luminanceMeans;
+	std::vector<nbFloat32> m_luminanceM2;
+};
+
+inline nbUint32 ConvergenceBuffer::getPixelIdx(const glm::uvec2& pixel) const
+{
+	return pixel.y * m_size.x + pixel.x;
+}
+
+inline const glm::uvec2& ConvergenceBuffer::getSize() const
+{
+	return m_size;
+}
+
+inline nbUint32 ConvergenceBuffer::getNbSamples(nbUint32 pixelIdx) const
+{
+	return m_nbSamples[pixelIdx];
+}
+
+inline const Spectrum& ConvergenceBuffer::getMean(nbUint32 pixelIdx) const
+{
+	return m_means[pixelIdx];
+}
+}}}}
\ No newline at end of file
@@ -0,0 +1,45 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include "BasicTypes.h"
+#include <vector>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Scheduler
+{
+// Rectangle of pixels. max is exclusive.
+struct Tile
+{
+	glm::uvec2 min;
+	glm::uvec2 max;
+
+	inline nbUint32 getNbPixels() const { return (max.x - min.x) * (max.y - min.y); }
+};
+
+using TileArray = std::vector<Tile>;
+
+// Cut the image in tiles of tileSize pixels, row by row. Border tiles are clamped to the image.
+inline TileArray buildTiles(const glm::uvec2& imageSize, nbUint32 tileSize)
+{
+	NEBULA_ASSERT(tileSize > 0u);
+
+	TileArray tiles;
+	for (nbUint32 y = 0u; y < imageSize.y; y += tileSize)
+	{
+		for (nbUint32 x = 0u; x < imageSize.x; x += tileSize)
+		{
+			Tile tile;
+			tile.min = glm::uvec2(x, y);
+			tile.max = glm::min(tile.min + glm::uvec2(tileSize), imageSize);
+			tiles.push_back(tile);
+		}
+	}
+
+	return tiles;
+}
+}}}}
\ No newline at end of file
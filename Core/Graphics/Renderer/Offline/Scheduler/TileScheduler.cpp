@@ -0,0 +1,249 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#include "stdafx.h"
+#include "TileScheduler.h"
+#include "tbb/tbb.h"
+#include <algorithm>
+#include <chrono>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Scheduler
+{
+	namespace
+	{
+		// Position of (x, y) along the hilbert curve covering a n * n grid. n must be a power of two.
+		// @See: https://en.wikipedia.org/wiki/Hilbert_curve
+		nbUint64 getHilbertIndex(nbUint32 n, nbUint32 x, nbUint32 y)
+		{
+			nbUint64 d = 0u;
+			for (nbUint32 s = n / 2u; s > 0u; s /= 2u)
+			{
+				const nbUint32 rx = (x & s) ? 1u : 0u;
+				const nbUint32 ry = (y & s) ? 1u : 0u;
+				d += (nbUint64)s * s * ((3u * rx) ^ ry);
+
+				if (ry == 0u)
+				{
+					if (rx == 1u)
+					{
+						x = n - 1u - x;
+						y = n - 1u - y;
+					}
+
+					std::swap(x, y);
+				}
+			}
+
+			return d;
+		}
+
+		glm::uvec2 getTileCenter(const Tile& tile)
+		{
+			return (tile.min + tile.max) / 2u;
+		}
+	}
+
+	TileScheduler::TileScheduler(const TileSchedulerSettings& settings)
+	: m_settings(settings)
+	{
+		m_settings.m_minTileSize = std::max(1u, m_settings.m_minTileSize);
+	}
+
+	void TileScheduler::orderTiles(TileArray& tiles, const glm::uvec2& imageSize, TileOrder order)
+	{
+		if (tiles.empty())
+			return;
+
+		if (order == TileOrder::Spiral)
+		{
+			// Rings around the image center, each ring walked by angle.
+			const glm::vec2 center = glm::vec2(imageSize) * 0.5f;
+			const nbFloat32 ringSize = (nbFloat32)std::max(1u, tiles[0].max.x - tiles[0].min.x);
+
+			auto spiralKey = [&](const Tile& tile)
+			{
+				const glm::vec2 d = glm::vec2(getTileCenter(tile)) - center;
+				const nbFloat32 ring = std::floor(std::max(std::abs(d.x), std::abs(d.y)) / ringSize);
+				return std::make_pair(ring, std::atan2(d.y, d.x));
+			};
+
+			std::stable_sort(tiles.begin(), tiles.end(), [&](const Tile& a, const Tile& b)
+			{
+				return spiralKey(a) < spiralKey(b);
+			});
+		}
+		else if (order == TileOrder::Hilbert)
+		{
+			nbUint32 n = 1u;
+			while (n < std::max(imageSize.x, imageSize.y))
+				n *= 2u;
+
+			std::stable_sort(tiles.begin(), tiles.end(), [&](const Tile& a, const Tile& b)
+			{
+				const glm::uvec2 ca = getTileCenter(a);
+				const glm::uvec2 cb = getTileCenter(b);
+				return getHilbertIndex(n, ca.x, ca.y) < getHilbertIndex(n, cb.x, cb.y);
+			});
+		}
+		else
+		{
+			std::stable_sort(tiles.begin(), tiles.end(), [](const Tile& a, const Tile& b)
+			{
+				return a.min.y != b.min.y ? a.min.y < b.min.y : a.min.x < b.min.x;
+			});
+		}
+	}
+
+	void TileScheduler::run(const TileArray& tiles, const glm::uvec2& imageSize, const RenderTileFunc& renderTile)
+	{
+		m_costs.clear();
+		if (tiles.empty())
+			return;
+
+		const nbUint32 nbThreads = m_settings.m_nbThreads ? m_settings.m_nbThreads : (nbUint32)std::max(1, tbb::this_task_arena::max_concurrency());
+
+		TileArray orderedTiles = tiles;
+		orderTiles(orderedTiles, imageSize, m_settings.m_order);
+
+		// Contiguous blocks keep neighbouring tiles on the same worker.
+		m_queues.clear();
+		for (nbUint32 i = 0u; i < nbThreads; ++i)
+			m_queues.push_back(std::make_unique<WorkerQueue>());
+
+		const nbUint32 nbTiles = (nbUint32)orderedTiles.size();
+		for (nbUint32 i = 0u; i < nbTiles; ++i)
+			m_queues[(nbUint64)i * nbThreads / nbTiles]->tiles.push_back(orderedTiles[i]);
+
+		m_workerCosts.assign(nbThreads, std::vector<TileCost>());
+
+		// Workers are tasks of an arena sized for them, so the parallel loops run inside the tiles
+		// share the same threads instead of oversubscribing the cores.
+		tbb::task_arena arena(nbThreads);
+		arena.execute([&]()
+		{
+			tbb::task_group workers;
+			for (nbUint32 i = 0u; i < nbThreads; ++i)
+				workers.run([this, i, &renderTile]() { workerLoop(i, renderTile); });
+
+			workers.wait();
+		});
+
+		for (const auto& workerCosts : m_workerCosts)
+			m_costs.insert(m_costs.end(), workerCosts.begin(), workerCosts.end());
+	}
+
+	void TileScheduler::workerLoop(nbUint32 workerIdx, const RenderTileFunc& renderTile)
+	{
+		// A worker finding no tile to pop or steal ends, its thread goes back to the arena where it helps the
+		// parallel loops of the last tiles instead of spinning. Tiles are only added by a stealer to its own queue,
+		// which it drains before ending, so no tile is left behind.
+		Tile tile;
+		while (popLocal(workerIdx, tile) || steal(workerIdx, tile))
+		{
+			// Isolated, so a thread waiting in the parallel loops of the tile cannot pick up another worker loop
+			// and render its tiles inside this timed region.
+			const auto start = std::chrono::high_resolution_clock::now();
+			tbb::this_task_arena::isolate([&]() { renderTile(tile); });
+			const std::chrono::duration<nbFloat64> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+			m_workerCosts[workerIdx].push_back({ tile, elapsed.count() / std::max(1u, tile.getNbPixels()) });
+		}
+	}
+
+	nbBool TileScheduler::popLocal(nbUint32 workerIdx, Tile& dst)
+	{
+		WorkerQueue& queue = *m_queues[workerIdx];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (queue.tiles.empty())
+			return false;
+
+		dst = queue.tiles.front();
+		queue.tiles.pop_front();
+		return true;
+	}
+
+	nbBool TileScheduler::steal(nbUint32 workerIdx, Tile& dst)
+	{
+		const nbUint32 nbQueues = (nbUint32)m_queues.size();
+
+		for (nbUint32 i = 1u; i < nbQueues; ++i)
+		{
+			WorkerQueue& victim = *m_queues[(workerIdx + i) % nbQueues];
+			{
+				std::lock_guard<std::mutex> lock(victim.mutex);
+				if (victim.tiles.empty())
+					continue;
+
+				// The back is the furthest from what the victim is rendering.
+				dst = victim.tiles.back();
+				victim.tiles.pop_back();
+			}
+
+			// Halve the stolen tile along its longest side and keep the other half for later.
+			if (canSplit(dst))
+			{
+				Tile other = dst;
+				const glm::uvec2 size = dst.max - dst.min;
+
+				if (size.x >= size.y)
+					dst.max.x = other.min.x = dst.min.x + size.x / 2u;
+				else
+					dst.max.y = other.min.y = dst.min.y + size.y / 2u;
+
+				WorkerQueue& own = *m_queues[workerIdx];
+				std::lock_guard<std::mutex> lock(own.mutex);
+				own.tiles.push_back(other);
+			}
+
+			return true;
+		}
+
+		return false;
+	}
+
+	nbBool TileScheduler::canSplit(const Tile& tile) const
+	{
+		const glm::uvec2 size = tile.max - tile.min;
+		return std::max(size.x, size.y) >= 2u * m_settings.m_minTileSize;
+	}
+
+	TileArray TileScheduler::refineTiles() const
+	{
+		TileArray tiles;
+		if (m_costs.empty())
+			return tiles;
+
+		std::vector<nbFloat64> costs;
+		for (const TileCost& cost : m_costs)
+			costs.push_back(cost.secondsPerPixel);
+
+		std::nth_element(costs.begin(), costs.begin() + costs.size() / 2u, costs.end());
+		const nbFloat64 medianCost = costs[costs.size() / 2u];
+
+		for (const TileCost& cost : m_costs)
+		{
+			const Tile& tile = cost.tile;
+			const glm::uvec2 size = tile.max - tile.min;
+
+			if (cost.secondsPerPixel <= 2.0 * medianCost || std::min(size.x, size.y) < 2u * m_settings.m_minTileSize)
+			{
+				tiles.push_back(tile);
+				continue;
+			}
+
+			const glm::uvec2 mid = tile.min + size / 2u;
+			tiles.push_back({ tile.min, mid });
+			tiles.push_back({ glm::uvec2(mid.x, tile.min.y), glm::uvec2(tile.max.x, mid.y) });
+			tiles.push_back({ glm::uvec2(tile.min.x, mid.y), glm::uvec2(mid.x, tile.max.y) });
+			tiles.push_back({ mid, tile.max });
+		}
+
+		return tiles;
+	}
+
+}}}}
\ No newline at end of file
@@ -0,0 +1,87 @@
+//========================================================================
+// Copyright (c) Yann Clotioloman Yeo, 2018
+//
+//	Author					: Yann Clotioloman Yeo
+//	E-Mail					: nebularender@gmail.com
+//========================================================================
+
+#pragma once
+
+#include "Tile.h"
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace Graphics { namespace Renderer { namespace Offline { namespace Scheduler
+{
+enum class TileOrder
+{
+	RowMajor,
+	Spiral,
+	Hilbert
+};
+
+struct TileSchedulerSettings
+{
+	TileOrder m_order = TileOrder::Spiral;
+
+	// Tiles are never split below this size.
+	nbUint32 m_minTileSize = 8u;
+
+	// Zero uses one worker per thread of the current tbb arena.
+	nbUint32 m_nbThreads = 0u;
+};
+
+struct TileCost
+{
+	Tile tile;
+	nbFloat64 secondsPerPixel;
+};
+
+// Offline tile scheduler.
+// Ordered tiles are dealt in contiguous blocks to per worker deques. A worker pops its own tiles from the front
+// and, once empty, steals from the back of another worker. Large stolen tiles are halved so the end of a frame
+// is shared between all workers. The measured cost of each tile drives the tile sizes of the next frame.
+// Workers are tbb tasks, tiles may use tbb parallel loops internally.
+class TileScheduler
+{
+public:
+	using RenderTileFunc = std::function<void(const Tile& tile)>;
+
+	explicit TileScheduler(const TileSchedulerSettings& settings);
+
+	void run(const TileArray& tiles, const glm::uvec2& imageSize, const RenderTileFunc& renderTile);
+
+	// Last run tiles where the expensive ones are split in four.
+	TileArray refineTiles() const;
+
+	const std::vector<TileCost>& getLastCosts() const;
+
+	static void orderTiles(TileArray& tiles, const glm::uvec2& imageSize, TileOrder order);
+
+private:
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<Tile> tiles;
+	};
+
+	void workerLoop(nbUint32 workerIdx, const RenderTileFunc& renderTile);
+	nbBool popLocal(nbUint32 workerIdx, Tile& dst);
+	nbBool steal(nbUint32 workerIdx, Tile& dst);
+	nbBool canSplit(const Tile& tile) const;
+
+	TileSchedulerSettings m_settings;
+
+	std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+
+	std::vector<std::vector<TileCost>> m_workerCosts;
+	std::vector<TileCost> m_costs;
+};
+
+inline const std::vector<TileCost>& TileScheduler::getLastCosts() const
+{
+	return m_costs;
+}
+}}}}
\ No newline at end of file